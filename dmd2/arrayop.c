@@ -60,6 +60,33 @@ FuncDeclaration *buildArrayOp(Identifier *ident, BinExp *exp, Scope *sc, Loc loc
         new ArrayLengthExp(Loc(), new IdentifierExp(Loc(), p->ident)),
         new ExpStatement(Loc(), loopbody),
         Loc());
+#if IN_LLVM
+    /* The loop body indexes the operands through their .ptr, so the loop
+     * has no early exits and the LLVM loop vectorizer can version it with a
+     * runtime overlap check. Do the bounds checks once before the loop:
+     *  if (p.length) { cast(void)p1[p.length - 1]; ... }
+     */
+    Statements *checks = new Statements();
+    for (size_t i = 1; i < fparams->dim; i++)
+    {
+        Parameter *param = (*fparams)[i];
+        Type *tb = param->type->toBasetype();
+        if (tb->ty != Tarray && tb->ty != Tsarray)
+            continue;
+        Expression *last = new MinExp(Loc(),
+            new ArrayLengthExp(Loc(), new IdentifierExp(Loc(), p->ident)),
+            new IntegerExp(Loc(), 1, Type::tsize_t));
+        Expression *ec = new ArrayExp(Loc(), new IdentifierExp(Loc(), param->ident), last);
+        checks->push(new ExpStatement(Loc(), new CastExp(Loc(), ec, Type::tvoid)));
+    }
+    if (checks->dim)
+    {
+        Statement *sif = new IfStatement(Loc(), NULL,
+            new ArrayLengthExp(Loc(), new IdentifierExp(Loc(), p->ident)),
+            new CompoundStatement(Loc(), checks), NULL);
+        s1 = new CompoundStatement(Loc(), sif, s1);
+    }
+#endif
     //printf("%s\n", s1->toChars());
     Statement *s2 = new ReturnStatement(Loc(), new IdentifierExp(Loc(), p->ident));
     //printf("s2: %s\n", s2->toChars());
@@ -452,6 +479,10 @@ Expression *buildArrayLoop(Expression *e, Parameters *fparams)
             Parameter *param = new Parameter(STCconst, e->type, id, NULL);
             fparams->shift(param);
             Expression *ie = new IdentifierExp(Loc(), id);
+#if IN_LLVM
+            // Bounds checked once in buildArrayOp()
+            ie = new DotIdExp(Loc(), ie, Id::ptr);
+#endif
             Expression *index = new IdentifierExp(Loc(), Id::p);
             result = new ArrayExp(Loc(), ie, index);
         }
@@ -462,6 +493,10 @@ Expression *buildArrayLoop(Expression *e, Parameters *fparams)
             Parameter *param = new Parameter(STCconst, e->type, id, NULL);
             fparams->shift(param);
             Expression *ie = new IdentifierExp(Loc(), id);
+#if IN_LLVM
+            // Bounds checked once in buildArrayOp()
+            ie = new DotIdExp(Loc(), ie, Id::ptr);
+#endif
             Expression *index = new IdentifierExp(Loc(), Id::p);
             result = new ArrayExp(Loc(), ie, index);
         }
@@ -302,7 +302,28 @@ void gendocfile(Module *m)
             mbuf.write(file.buffer, file.len);
         }
     }
+#if IN_LLVM
+    /* Parse the predefined macros only once, and give each module a copy of
+     * them, as they can be redefined per module.
+     */
+    static Macro *basemacrotable;
+    static Escape *baseescapetable;
+    static bool basetables_done;
+    if (!basetables_done)
+    {
+        basetables_done = true;
+        DocComment::parseMacros(&baseescapetable, &basemacrotable, (utf8_t *)mbuf.data, mbuf.offset);
+    }
+    assert(!m->macrotable && !m->escapetable);
+    m->macrotable = Macro::copyTable(basemacrotable);
+    if (baseescapetable)
+    {
+        m->escapetable = new Escape;
+        *m->escapetable = *baseescapetable;
+    }
+#else
     DocComment::parseMacros(&m->escapetable, &m->macrotable, (utf8_t *)mbuf.data, mbuf.offset);
+#endif
 
     Scope *sc = Scope::createGlobal(m);      // create root scope
 
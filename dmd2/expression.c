@@ -7058,6 +7058,10 @@ Expression *FileExp::semantic(Scope *sc)
         else
         {
             f.ref = 1;
+#if IN_LLVM
+            if (global.params.hashInputs)
+                sc->module->addStringImport(name, f.buffer, f.len);
+#endif
             se = new StringExp(loc, f.buffer, f.len);
         }
     }
@@ -31,6 +31,10 @@
 #include "rmem.h"
 #include "visitor.h"
 
+#if IN_LLVM
+#include "../gen/uda.h"
+#endif
+
 Expression *addInvariant(Loc loc, Scope *sc, AggregateDeclaration *ad, VarDeclaration *vthis, bool direct);
 
 void genCmain(Scope *sc);
@@ -2354,6 +2358,9 @@ void FuncDeclaration::semantic3(Scope *sc)
      * done by TemplateInstance::semantic.
      * Otherwise, error gagging should be temporarily ungagged by functionSemantic3.
      */
+#if IN_LLVM
+    checkFuncDeclUDAs(this);
+#endif
     semanticRun = PASSsemantic3done;
     semantic3Errors = (global.errors != oldErrors) || (fbody && fbody->isErrorStatement());
     if (type->ty == Terror)
@@ -123,6 +123,8 @@ struct Param
     bool color;         // use ANSI colors in console output
     bool cov;           // generate code coverage data
     unsigned char covPercent;   // 0..100 code coverage percentage required
+    bool covFast;       // -cov=fast: unlocked counters per basic block
+    bool hashInputs;    // -incremental: hash sources and string imports
     bool ignoreUnsupportedPragmas;      // rather than error on them
     bool enforcePropertySyntax;
     bool addMain; // LDC_FIXME: Implement.
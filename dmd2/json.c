@@ -899,3 +899,58 @@ void json_generate(OutBuffer *buf, Modules *modules)
     json.arrayEnd();
     json.removeComma();
 }
+
+#if IN_LLVM
+static void writeUint32(FILE *out, unsigned value)
+{
+    unsigned char bytes[4];
+    for (int i = 0; i < 4; i++)
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    fwrite(bytes, 1, 4, out);
+}
+
+void json_generate(FILE *out, Modules *modules, bool records)
+{
+    OutBuffer buf;
+
+    if (records)
+    {
+        fwrite("DJSN", 1, 4, out);
+        writeUint32(out, 1);
+        for (size_t i = 0; i < modules->dim; i++)
+        {
+            Module *m = (*modules)[i];
+            if (global.params.verbose)
+                fprintf(global.stdmsg, "json gen %s\n", m->toChars());
+            buf.reset();
+            ToJsonVisitor json(&buf);
+            m->accept(&json);
+            writeUint32(out, (unsigned)buf.offset);
+            fwrite(buf.data, 1, buf.offset, out);
+        }
+        return;
+    }
+
+    ToJsonVisitor json(&buf);
+
+    json.arrayStart();
+    for (size_t i = 0; i < modules->dim; i++)
+    {
+        Module *m = (*modules)[i];
+        if (global.params.verbose)
+            fprintf(global.stdmsg, "json gen %s\n", m->toChars());
+        m->accept(&json);
+
+        /* The visitor only ever looks back at the last two bytes, the ",\n"
+         * after the module, so everything before them can be written out.
+         */
+        assert(buf.offset >= 2);
+        fwrite(buf.data, 1, buf.offset - 2, out);
+        memmove(buf.data, buf.data + buf.offset - 2, 2);
+        buf.offset = 2;
+    }
+    json.arrayEnd();
+    json.removeComma();
+    fwrite(buf.data, 1, buf.offset, out);
+}
+#endif
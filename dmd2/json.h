@@ -17,10 +17,24 @@
 #endif /* __DMC__ */
 
 #include "arraytypes.h"
+#if IN_LLVM
+#include <stdio.h>
+#endif
 
 struct OutBuffer;
 
 void json_generate(OutBuffer *, Modules *);
 
+#if IN_LLVM
+/* Write the JSON description of the modules to out, one module at a time.
+ *
+ * If records is set, the output is instead a sequence of records which can be
+ * skipped without parsing them: the 4 bytes "DJSN", a 4-byte version (1), and
+ * for each module, its JSON object preceded by its length in bytes. All
+ * integers are 32 bits, little-endian.
+ */
+void json_generate(FILE *out, Modules *, bool records);
+#endif
+
 #endif /* DMD_JSON_H */
 
@@ -32,6 +32,28 @@ utf8_t *memdup(const utf8_t *p, size_t len)
     return (utf8_t *)memcpy(mem.xmalloc(len), p, len);
 }
 
+#if IN_LLVM
+/* Incremented whenever a macro is (re)defined, which invalidates all
+ * memoized expansions.
+ */
+static unsigned generation;
+
+/* Incremented whenever an expansion is cut short because of recursion,
+ * which makes its result depend on the context.
+ */
+static unsigned recursioncutoffs;
+
+static bool refersToArgs(const utf8_t *text, size_t textlen)
+{
+    for (size_t i = 0; i + 1 < textlen; i++)
+    {
+        if (text[i] == '$' && (isdigit(text[i + 1]) || text[i + 1] == '+'))
+            return true;
+    }
+    return false;
+}
+#endif
+
 Macro::Macro(const utf8_t *name, size_t namelen, const utf8_t *text, size_t textlen)
 {
     next = NULL;
@@ -42,6 +64,12 @@ Macro::Macro(const utf8_t *name, size_t namelen, const utf8_t *text, size_t text
     this->text = text;
     this->textlen = textlen;
     inuse = 0;
+#if IN_LLVM
+    usesargs = refersToArgs(text, textlen);
+    expansion = NULL;
+    expansionlen = 0;
+    expansiongen = 0;
+#endif
 }
 
 
@@ -68,6 +96,9 @@ Macro *Macro::define(Macro **ptable, const utf8_t *name, size_t namelen, const u
     Macro *table;
 
     //assert(ptable);
+#if IN_LLVM
+    generation++;
+#endif
     for (table = *ptable; table; table = table->next)
     {
         if (table->namelen == namelen &&
@@ -75,6 +106,9 @@ Macro *Macro::define(Macro **ptable, const utf8_t *name, size_t namelen, const u
         {
             table->text = text;
             table->textlen = textlen;
+#if IN_LLVM
+            table->usesargs = refersToArgs(text, textlen);
+#endif
             return table;
         }
     }
@@ -84,6 +118,25 @@ Macro *Macro::define(Macro **ptable, const utf8_t *name, size_t namelen, const u
     return table;
 }
 
+#if IN_LLVM
+/**********************************************************
+ * Return a copy of the macro table, sharing the names and texts.
+ */
+
+Macro *Macro::copyTable(Macro *table)
+{
+    Macro *result = NULL;
+    Macro **ptail = &result;
+    for (; table; table = table->next)
+    {
+        Macro *m = new Macro(table->name, table->namelen, table->text, table->textlen);
+        *ptail = m;
+        ptail = &m->next;
+    }
+    return result;
+}
+#endif
+
 /**********************************************************
  * Given buffer p[0..end], extract argument marg[0..marglen].
  * Params:
@@ -234,7 +287,12 @@ void Macro::expand(OutBuffer *buf, size_t start, size_t *pend,
 
     static int nest;
     if (nest > 100)             // limit recursive expansion
+    {
+#if IN_LLVM
+        recursioncutoffs++;
+#endif
         return;
+    }
     nest++;
 
     size_t end = *pend;
@@ -394,6 +452,9 @@ void Macro::expand(OutBuffer *buf, size_t start, size_t *pend,
                 {
                     if (m->inuse && marglen == 0)
                     {   // Remove macro invocation
+#if IN_LLVM
+                        recursioncutoffs++;
+#endif
                         buf->remove(u, v + 1 - u);
                         end -= v + 1 - u;
                     }
@@ -413,7 +474,24 @@ void Macro::expand(OutBuffer *buf, size_t start, size_t *pend,
                          *   marg is same as arg (with blue paint added)
                          * Just leave in place.
                          */
+#if IN_LLVM
+                        recursioncutoffs++;
+#endif
                     }
+#if IN_LLVM
+                    else if (m->expansion && m->expansiongen == generation)
+                    {
+                        /* The macro doesn't refer to its arguments, so it
+                         * expands to the same text as last time.
+                         */
+                        buf->remove(u, v + 1 - u);
+                        buf->insert(u, m->expansion, m->expansionlen);
+                        end += m->expansionlen;
+                        end -= v + 1 - u;
+                        u += m->expansionlen;
+                        continue;
+                    }
+#endif
                     else
                     {
                         //printf("\tmacro '%.*s'(%.*s) = '%.*s'\n", m->namelen, m->name, marglen, marg, m->textlen, m->text);
@@ -431,9 +509,20 @@ void Macro::expand(OutBuffer *buf, size_t start, size_t *pend,
                         // Scan replaced text for further expansion
                         m->inuse++;
                         size_t mend = v + 1 + 2+m->textlen+2;
+#if IN_LLVM
+                        unsigned cutoffs = recursioncutoffs;
+#endif
                         expand(buf, v + 1, &mend, marg, marglen);
                         end += mend - (v + 1 + 2+m->textlen+2);
                         m->inuse--;
+#if IN_LLVM
+                        if (!m->usesargs && cutoffs == recursioncutoffs)
+                        {
+                            m->expansion = memdup(buf->data + v + 1, mend - (v + 1));
+                            m->expansionlen = mend - (v + 1);
+                            m->expansiongen = generation;
+                        }
+#endif
 
                         buf->remove(u, v + 1 - u);
                         end -= v + 1 - u;
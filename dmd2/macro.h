@@ -33,11 +33,22 @@ struct Macro
 
     int inuse;                  // macro is in use (don't expand)
 
+#if IN_LLVM
+    bool usesargs;              // text refers to the arguments ($0..$9, $+)
+
+    const utf8_t *expansion;    // memoized expansion if !usesargs, or NULL
+    size_t expansionlen;
+    unsigned expansiongen;      // macro definitions generation of expansion
+#endif
+
     Macro(const utf8_t *name, size_t namelen, const utf8_t *text, size_t textlen);
     Macro *search(const utf8_t *name, size_t namelen);
 
   public:
     static Macro *define(Macro **ptable, const utf8_t *name, size_t namelen, const utf8_t *text, size_t textlen);
+#if IN_LLVM
+    static Macro *copyTable(Macro *table);
+#endif
 
     void expand(OutBuffer *buf, size_t start, size_t *pend,
         const utf8_t *arg, size_t arglen);
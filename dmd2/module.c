@@ -25,6 +25,9 @@
 #include "lexer.h"
 #include "attrib.h"
 #include "target.h"
+#if IN_LLVM
+#include "llvm/Support/MD5.h"
+#endif
 
 AggregateDeclaration *Module::moduleinfo;
 
@@ -139,6 +142,7 @@ Module::Module(const char *filename, Identifier *ident, int doDocComment, int do
     this->arrayfuncs = 0;
     d_cover_valid = NULL;
     d_cover_data = NULL;
+    d_cover_blocks = NULL;
 #endif
 }
 
@@ -324,6 +328,24 @@ bool Module::read(Loc loc)
     return true;
 }
 
+#if IN_LLVM
+static std::string hashBuffer(const unsigned char *buf, size_t len)
+{
+    llvm::MD5 hash;
+    hash.update(llvm::ArrayRef<uint8_t>(buf, len));
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    llvm::SmallString<32> str;
+    llvm::MD5::stringifyResult(result, str);
+    return str.str();
+}
+
+void Module::addStringImport(const char *path, const unsigned char *buf, size_t len)
+{
+    stringImportHashes.push_back(std::string(path) + ' ' + hashBuffer(buf, len));
+}
+#endif
+
 Module *Module::parse(bool gen_docs)
 {
     //printf("Module::parse(srcfile='%s') this=%p\n", srcfile->name->toChars(), this);
@@ -512,6 +534,10 @@ Module *Module::parse(bool gen_docs)
 #endif
         return this;
     }
+#if IN_LLVM
+    if (global.params.hashInputs)
+        srcHash = hashBuffer(buf, buflen);
+#endif
     {
 #if IN_LLVM
         Parser p(this, buf, buflen, gen_docs);
@@ -526,10 +552,14 @@ Module *Module::parse(bool gen_docs)
             ++global.errors;
     }
 
+#if IN_LLVM
+    srcfile->freeBuffer();
+#else
     if (srcfile->ref == 0)
         ::free(srcfile->buffer);
     srcfile->buffer = NULL;
     srcfile->len = 0;
+#endif
 
     /* The symbol table into which the module is to be inserted.
      */
@@ -27,6 +27,9 @@ class VarDeclaration;
 class Library;
 
 #if IN_LLVM
+#include <string>
+#include <vector>
+
 class DValue;
 namespace llvm {
     class LLVMContext;
@@ -200,10 +203,18 @@ public:
     // array ops emitted in this module already
     AA *arrayfuncs;
 
+    // MD5 of the source file contents (hex), for -incremental
+    std::string srcHash;
+    // Path and MD5 of each file read by import("file"), for -incremental
+    std::vector<std::string> stringImportHashes;
+    void addStringImport(const char *path, const unsigned char *buf, size_t len);
+
     // Coverage analysis
     llvm::GlobalVariable* d_cover_valid;  // private immutable size_t[] _d_cover_valid;
     llvm::GlobalVariable* d_cover_data;   // private uint[] _d_cover_data;
     std::vector<size_t> d_cover_valid_init; // initializer for _d_cover_valid
+    llvm::GlobalVariable* d_cover_blocks; // -cov=fast: private uint[] _d_cover_blocks;
+    std::vector<std::vector<unsigned> > d_cover_block_lines; // lines counted by each _d_cover_blocks element
 #endif
 
     Module *isModule() { return this; }
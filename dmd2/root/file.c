@@ -31,6 +31,9 @@
 #include <errno.h>
 #include <unistd.h>
 #include <utime.h>
+#if IN_LLVM
+#include <sys/mman.h>
+#endif
 #endif
 
 #include "filename.h"
@@ -63,6 +66,9 @@ File::File(const char *n)
 
 File::~File()
 {
+#if IN_LLVM
+    freeBuffer();
+#else
     if (buffer)
     {
         if (ref == 0)
@@ -72,7 +78,67 @@ File::~File()
             UnmapViewOfFile(buffer);
 #endif
     }
+#endif
+}
+
+#if IN_LLVM
+void File::freeBuffer()
+{
+    if (buffer)
+    {
+        if (ref == 0)
+            mem.xfree(buffer);
+#if _WIN32
+        if (ref == 2)
+            UnmapViewOfFile(buffer);
+#elif POSIX
+        if (ref == 2)
+            munmap(buffer, len + 2);
+#endif
+    }
+    buffer = NULL;
+    len = 0;
+}
+#endif
+
+#if IN_LLVM && POSIX
+/* Files at least this large are mapped into memory instead of being copied
+ * into a heap buffer.
+ */
+static const size_t mmapThreshold = 64 * 1024;
+
+/*************************************
+ * Map the file contents followed by (at least) two zero bytes as sentinel for
+ * the scanner, without copying them.
+ * Returns:
+ *      the mapping, or NULL on failure
+ */
+
+static unsigned char *mapFile(int fd, size_t size)
+{
+    size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t maplen = (size + 2 + pagesize - 1) & ~(pagesize - 1);
+
+    /* Reserve zero-filled memory for the whole range first, and map the file
+     * over it. The rest of the last page of the file is zeroed by the kernel,
+     * and if the file ends at or just before a page boundary, the sentinel
+     * ends up in the reserved page following it.
+     * The mapping is private and writable, so writes to the buffer behave
+     * just like with a heap copy.
+     */
+    void *p = mmap(NULL, maplen, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    if (mmap(p, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, 0) == MAP_FAILED)
+    {
+        munmap(p, maplen);
+        return NULL;
+    }
+    return (unsigned char *)p;
 }
+#endif
 
 /*************************************
  */
@@ -106,6 +172,19 @@ bool File::read()
         goto err2;
     }
     size = (size_t)buf.st_size;
+#if IN_LLVM
+    if (size >= mmapThreshold)
+    {
+        buffer = mapFile(fd, size);
+        if (buffer)
+        {
+            close(fd);
+            ref = 2;
+            len = size;
+            return false;
+        }
+    }
+#endif
     buffer = (unsigned char *) ::malloc(size + 2);
     if (!buffer)
     {
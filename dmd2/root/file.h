@@ -25,6 +25,9 @@ struct FileName;
 struct File
 {
     int ref;                    // != 0 if this is a reference to someone else's buffer
+#if IN_LLVM
+                                // 2 if the buffer is a memory mapping of the file
+#endif
     unsigned char *buffer;      // data for our file
     size_t len;                 // amount of data in buffer[]
 
@@ -57,6 +60,13 @@ struct File
     }
 
     void remove();              // delete file
+
+#if IN_LLVM
+    /* Release the buffer if we own it
+     */
+
+    void freeBuffer();
+#endif
 };
 
 #endif
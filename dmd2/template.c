@@ -5687,6 +5687,9 @@ TemplateInstance::TemplateInstance(Loc loc, Identifier *ident)
     this->tinst = NULL;
     this->tnext = NULL;
     this->minst = NULL;
+#if IN_LLVM
+    this->emittingModule = NULL;
+#endif
     this->deferred = NULL;
     this->argsym = NULL;
     this->aliasdecl = NULL;
@@ -5718,6 +5721,9 @@ TemplateInstance::TemplateInstance(Loc loc, TemplateDeclaration *td, Objects *ti
     this->tinst = NULL;
     this->tnext = NULL;
     this->minst = NULL;
+#if IN_LLVM
+    this->emittingModule = NULL;
+#endif
     this->deferred = NULL;
     this->argsym = NULL;
     this->aliasdecl = NULL;
@@ -7388,6 +7394,10 @@ Dsymbols *TemplateInstance::appendToModuleMember()
             a->push(this);
             if (mi->semanticRun >= PASSsemantic3done && mi->isRoot())
                 Module::addDeferredSemantic3(this);
+#if IN_LLVM
+            if (!emittingModule && mi->isRoot())
+                emittingModule = mi;
+#endif
             break;
         }
         if (this == (*a)[i])    // if already in Array
@@ -330,6 +330,9 @@ public:
     TemplateInstance *tinst;            // enclosing template instance
     TemplateInstance *tnext;            // non-first instantiated instances
     Module *minst;                      // the top module that instantiated this instance
+#if IN_LLVM
+    Module *emittingModule;             // the root module whose members this instance was appended to
+#endif
 
     TemplateInstance(Loc loc, Identifier *temp_id);
     TemplateInstance(Loc loc, TemplateDeclaration *tempdecl, Objects *tiargs);
@@ -34,6 +34,12 @@ struct CoverageParser : public cl::parser<unsigned char> {
       return false;
     }
 
+    if (Arg == "fast") {
+      Val = 0;
+      global.params.covFast = true;
+      return false;
+    }
+
     if (Arg.getAsInteger(0, Val)) {
       return O.error("'" + Arg +
                      "' value invalid for required coverage percentage");
@@ -51,10 +57,12 @@ cl::list<std::string> fileList(cl::Positional, cl::desc("files"));
 
 cl::list<std::string> runargs(
     "run",
-    cl::desc(
-        "Runs the resulting program, passing the remaining arguments to it"),
+    cl::desc("Runs the resulting program, passing the remaining arguments to "
+             "it (-run=jit runs it in-process, without linking)"),
     cl::Positional, cl::PositionalEatsArgs);
 
+bool runJIT = false;
+
 static cl::opt<ubyte, true> useDeprecated(
     cl::desc("Allow deprecated code/language features:"), cl::ZeroOrMore,
     cl::values(clEnumValN(0, "de", "Do not allow deprecated features"),
@@ -120,6 +128,10 @@ static cl::opt<ubyte, true>
                          clEnumValEnd),
               cl::location(global.params.symdebug), cl::init(0));
 
+cl::opt<bool> debugTypesSection(
+    "fdebug-types-section",
+    cl::desc("Emit aggregate debug info in DWARF type units (ELF only)"));
+
 cl::opt<bool> noAsm("noasm", cl::desc("Disallow use of inline assembler"));
 
 // Output file options
@@ -171,6 +183,11 @@ static cl::opt<bool, true> doJson("X", cl::desc("Generate JSON file"),
 cl::opt<std::string> jsonFile("Xf", cl::desc("Write JSON file to <filename>"),
                               cl::value_desc("filename"), cl::Prefix);
 
+cl::opt<bool>
+    jsonRecords("Xrecords",
+                cl::desc("Write the JSON file as length-prefixed records, "
+                         "one per module"));
+
 // Header generation options
 static cl::opt<bool, true>
     doHdrGen("H", cl::desc("Generate 'header' file"),
@@ -250,6 +267,18 @@ cl::opt<std::string>
     moduleDepsFile("deps", cl::desc("Write module dependencies to filename"),
                    cl::value_desc("filename"));
 
+cl::opt<std::string> incrementalStateFile(
+    "incremental",
+    cl::desc("Reuse the object files of modules whose sources, imports and "
+             "string imports are unchanged, keeping track of them in "
+             "<statefile>"),
+    cl::value_desc("statefile"));
+
+cl::opt<unsigned> codegenPartitions(
+    "codegen-partitions", cl::ZeroOrMore, cl::init(1), cl::value_desc("N"),
+    cl::desc("Split each module into N partitions for parallel machine "
+             "code generation, emitting an object file per partition"));
+
 // Provide a clang-like "-arch" for iOS targets.  It is used by the OS X based
 // tools to specify just the <arch><sub> part of the triple
 // <arch><sub>-<vendor>-<sys>-<abi>.  This differs from -march below that
@@ -391,6 +420,12 @@ cl::opt<bool> linkonceTemplates(
         "Use linkonce_odr linkage for template symbols instead of weak_odr"),
     cl::ZeroOrMore);
 
+cl::opt<bool> singleOwnerTemplates(
+    "single-owner-templates",
+    cl::desc("Define template instance functions only in the object file of "
+             "the root module owning the instance"),
+    cl::ZeroOrMore);
+
 cl::opt<bool> disableLinkerStripDead(
     "disable-linker-strip-dead",
     cl::desc("Do not try to remove unused symbols during linking"),
@@ -426,7 +461,8 @@ cl::opt<bool, true>
 
 cl::opt<unsigned char, true, CoverageParser> coverageAnalysis(
     "cov", cl::desc("Compile-in code coverage analysis\n(use -cov=n for n% "
-                    "minimum required coverage)"),
+                    "minimum required coverage, -cov=fast for approximate "
+                    "counts using counters per basic block)"),
     cl::location(global.params.covPercent), cl::ValueOptional, cl::init(127));
 
 // Useful if target OS does not have TLS or threads, or perhaps you are
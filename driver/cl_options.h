@@ -34,10 +34,13 @@ namespace cl = llvm::cl;
  */
 extern cl::list<std::string> fileList;
 extern cl::list<std::string> runargs;
+// Set by -run=jit
+extern bool runJIT;
 extern cl::opt<bool> compileOnly;
 extern cl::opt<bool, true> enforcePropertySyntax;
 extern cl::opt<bool> createStaticLib;
 extern cl::opt<bool> createSharedLib;
+extern cl::opt<bool> debugTypesSection;
 extern cl::opt<bool> noAsm;
 extern cl::opt<bool> dontWriteObj;
 extern cl::opt<std::string> objectFile;
@@ -51,10 +54,13 @@ extern cl::opt<bool, true> disableRedZone;
 extern cl::opt<std::string> ddocDir;
 extern cl::opt<std::string> ddocFile;
 extern cl::opt<std::string> jsonFile;
+extern cl::opt<bool> jsonRecords;
 extern cl::opt<std::string> hdrDir;
 extern cl::opt<std::string> hdrFile;
 extern cl::list<std::string> versions;
 extern cl::opt<std::string> moduleDepsFile;
+extern cl::opt<std::string> incrementalStateFile;
+extern cl::opt<unsigned> codegenPartitions;
 
 extern cl::opt<std::string> iosArch;
 extern cl::opt<std::string> mArch;
@@ -72,6 +78,7 @@ extern cl::opt<bool> disableFpElim;
 extern cl::opt<FloatABI::Type> mFloatABI;
 extern cl::opt<bool, true> singleObj;
 extern cl::opt<bool> linkonceTemplates;
+extern cl::opt<bool> singleOwnerTemplates;
 extern cl::opt<bool> disableLinkerStripDead;
 extern cl::opt<bool, true> disableTls;
 
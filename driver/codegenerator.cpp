@@ -14,12 +14,13 @@
 #include "module.h"
 #include "parse.h"
 #include "scope.h"
+#include "driver/cl_options.h"
+#include "driver/jit.h"
 #include "driver/toobj.h"
 #include "gen/logger.h"
+#include "gen/modules.h"
 #include "gen/runtime.h"
 
-void codegenModule(IRState *irs, Module *m, bool emitFullModuleInfo);
-
 namespace {
 Module *g_entrypointModule = nullptr;
 Module *g_dMainModule = nullptr;
@@ -174,8 +175,12 @@ void CodeGenerator::writeAndFreeLLModule(const char *filename) {
       {llvm::MDString::get(ir_->context(), Version)};
   IdentMetadata->addOperand(llvm::MDNode::get(ir_->context(), IdentNode));
 
-  writeModule(&ir_->module, filename);
-  global.params.objfiles->push(const_cast<char *>(filename));
+  if (opts::runJIT) {
+    addJITModule(ir_->module);
+  } else {
+    writeModule(&ir_->module, filename);
+    global.params.objfiles->push(const_cast<char *>(filename));
+  }
   delete ir_;
   ir_ = nullptr;
 }
@@ -0,0 +1,249 @@
+//===-- incremental.cpp ---------------------------------------------------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The state file contains one line per root module, consisting of the hex MD5
+// hash of its inputs followed by a space and the object file name.
+//
+//===----------------------------------------------------------------------===//
+
+#include "driver/incremental.h"
+#include "mars.h"
+#include "module.h"
+#include "mtype.h"
+#include "template.h"
+#include "driver/cl_options.h"
+#include "gen/logger.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <string.h>
+#include <tuple>
+
+namespace {
+/// Hash of the compiler version and command line.
+std::string buildKey;
+
+/// Input hashes of the previous build, by object file name.
+llvm::StringMap<std::string> previousHashes;
+
+/// Input hashes of the root modules of this build, by object file name.
+llvm::StringMap<std::string> currentHashes;
+
+/// Root modules whose object files are reused.
+llvm::SmallPtrSet<Module *, 16> upToDate;
+
+std::string toHex(llvm::MD5 &hash) {
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  llvm::SmallString<32> str;
+  llvm::MD5::stringifyResult(result, str);
+  return str.str();
+}
+
+void collectImports(Module *m, llvm::SmallPtrSetImpl<Module *> &seen,
+                    std::vector<Module *> &imports) {
+  for (size_t i = 0; i < m->aimports.dim; i++) {
+    Module *imp = m->aimports[i];
+    if (seen.insert(imp).second) {
+      imports.push_back(imp);
+      collectImports(imp, seen, imports);
+    }
+  }
+}
+
+/// Collects the modules the code of template instances depends on: those
+/// declaring the templates and the symbols and types of their arguments,
+/// including the instances these are part of.
+class InstanceDependencies {
+  llvm::SmallPtrSet<TemplateInstance *, 16> visited;
+
+  void add(RootObject *o) {
+    if (!o) {
+      return;
+    }
+    if (Tuple *tup = isTuple(o)) {
+      for (size_t i = 0; i < tup->objects.dim; i++) {
+        add(tup->objects[i]);
+      }
+      return;
+    }
+    if (Type *t = isType(o)) {
+      while (Type *next = t->nextOf()) {
+        t = next;
+      }
+      o = t;
+    }
+    if (Dsymbol *s = getDsymbol(o)) {
+      if (Module *m = s->getModule()) {
+        modules.insert(m);
+      }
+      if (TemplateInstance *ti = s->isInstantiated()) {
+        add(ti);
+      }
+    }
+  }
+
+public:
+  llvm::SmallPtrSet<Module *, 16> modules;
+
+  void add(TemplateInstance *ti) {
+    if (!visited.insert(ti).second) {
+      return;
+    }
+    if (Module *m = ti->tempdecl->getModule()) {
+      modules.insert(m);
+    }
+    for (size_t i = 0; i < ti->tdtypes.dim; i++) {
+      add(ti->tdtypes[i]);
+    }
+    if (TemplateInstance *outer = ti->tempdecl->isInstantiated()) {
+      add(outer);
+    }
+  }
+};
+
+void hashModule(llvm::MD5 &hash, Module *m) {
+  hash.update(m->srcHash);
+  for (const auto &s : m->stringImportHashes) {
+    hash.update(s);
+  }
+}
+
+/// Hashes the source of the module and of all modules it imports,
+/// transitively, as inlining and templates make the generated code depend on
+/// more than the interfaces of the direct imports. Files read by string
+/// imports (-J) are hashed along with the module containing the import.
+///
+/// The module also emits the template instances appended to its members (see
+/// TemplateInstance::appendToModuleMember()), no matter which root module
+/// instantiates them, so their names and whether they need codegen are hashed
+/// too. Their arguments may come from modules it doesn't import, e.g. another
+/// root module, whose sources and imports are hashed as well.
+std::string computeInputHash(Module *m) {
+  std::vector<std::string> instances;
+  InstanceDependencies deps;
+  for (size_t i = 0; m->members && i < m->members->dim; i++) {
+    TemplateInstance *ti = (*m->members)[i]->isTemplateInstance();
+    if (ti && !ti->isTemplateMixin()) {
+      instances.push_back(std::string(ti->toPrettyChars()) +
+                          (ti->needsCodegen() ? " codegen" : ""));
+      deps.add(ti);
+    }
+  }
+  std::sort(instances.begin(), instances.end());
+
+  llvm::SmallPtrSet<Module *, 32> seen;
+  seen.insert(m);
+  std::vector<Module *> imports;
+  collectImports(m, seen, imports);
+  for (auto dep : deps.modules) {
+    if (seen.insert(dep).second) {
+      imports.push_back(dep);
+      collectImports(dep, seen, imports);
+    }
+  }
+  std::sort(imports.begin(), imports.end(), [](Module *a, Module *b) {
+    return strcmp(a->srcfile->name->str, b->srcfile->name->str) < 0;
+  });
+
+  llvm::MD5 hash;
+  hash.update(buildKey);
+  hashModule(hash, m);
+  for (auto imp : imports) {
+    hash.update(imp->srcfile->name->str);
+    hashModule(hash, imp);
+  }
+  for (const auto &inst : instances) {
+    hash.update(inst);
+    hash.update(llvm::StringRef("", 1)); // separator
+  }
+  return toHex(hash);
+}
+
+void writeStateFile(const llvm::StringMap<std::string> &hashes) {
+  const char *filename = opts::incrementalStateFile.c_str();
+#if LDC_LLVM_VER >= 306
+  std::error_code errinfo;
+  llvm::raw_fd_ostream os(filename, errinfo, llvm::sys::fs::F_Text);
+  if (errinfo) {
+    error(Loc(), "cannot write incremental state file '%s': %s", filename,
+          errinfo.message().c_str());
+    fatal();
+  }
+#else
+  std::string errinfo;
+  llvm::raw_fd_ostream os(filename, errinfo, llvm::sys::fs::F_Text);
+  if (!errinfo.empty()) {
+    error(Loc(), "cannot write incremental state file '%s': %s", filename,
+          errinfo.c_str());
+    fatal();
+  }
+#endif
+  for (const auto &entry : hashes) {
+    os << entry.getValue() << ' ' << entry.getKey() << '\n';
+  }
+}
+}
+
+void loadIncrementalState(const std::vector<const char *> &args) {
+  llvm::MD5 hash;
+  hash.update(global.ldc_version);
+  for (auto arg : args) {
+    hash.update(arg);
+    hash.update(llvm::StringRef("", 1)); // separator
+  }
+  buildKey = toHex(hash);
+
+  auto buffer = llvm::MemoryBuffer::getFile(opts::incrementalStateFile);
+  if (!buffer) {
+    Logger::println("No incremental state in %s",
+                    opts::incrementalStateFile.c_str());
+    return;
+  }
+
+  llvm::StringRef rest = (*buffer)->getBuffer();
+  while (!rest.empty()) {
+    llvm::StringRef line;
+    std::tie(line, rest) = rest.split('\n');
+    llvm::StringRef hashStr, objfile;
+    std::tie(hashStr, objfile) = line.rtrim("\r").split(' ');
+    if (hashStr.size() == 32 && !objfile.empty()) {
+      previousHashes[objfile] = hashStr;
+    }
+  }
+}
+
+void planIncrementalBuild(Modules &modules) {
+  llvm::StringMap<std::string> reused;
+  for (unsigned i = 0; i < modules.dim; i++) {
+    Module *m = modules[i];
+    const char *objfile = m->objfile->name->str;
+    std::string &current = currentHashes[objfile];
+    current = computeInputHash(m);
+
+    auto it = previousHashes.find(objfile);
+    if (it != previousHashes.end() && it->getValue() == current &&
+        llvm::sys::fs::exists(objfile)) {
+      IF_LOG Logger::println("Reusing %s for %s", objfile, m->toChars());
+      upToDate.insert(m);
+      reused[objfile] = current;
+    }
+  }
+
+  writeStateFile(reused);
+}
+
+bool canReuseObjectFile(Module *m) { return upToDate.count(m) != 0; }
+
+void saveIncrementalState() { writeStateFile(currentHashes); }
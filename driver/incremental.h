@@ -0,0 +1,49 @@
+//===-- driver/incremental.h - Incremental compilation ----------*- C++ -*-===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Implements -incremental=<statefile>: The object files of root modules whose
+// inputs (their source, the sources of all modules they import transitively,
+// the template instances they emit and the command line) are unchanged since
+// the last build are reused instead of generating code for them again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LDC_DRIVER_INCREMENTAL_H
+#define LDC_DRIVER_INCREMENTAL_H
+
+#include "arraytypes.h"
+#include <vector>
+
+class Module;
+
+/**
+ * Reads the state file of the previous build. The command line is part of
+ * the inputs of every module.
+ */
+void loadIncrementalState(const std::vector<const char *> &args);
+
+/**
+ * Computes the input hashes of the given root modules and determines which
+ * object files can be reused. Until saveIncrementalState() is called, the
+ * state file only lists the reused modules, so that an aborted build doesn't
+ * leave stale entries behind.
+ */
+void planIncrementalBuild(Modules &modules);
+
+/**
+ * Returns true if the object file of the given root module is up to date.
+ */
+bool canReuseObjectFile(Module *m);
+
+/**
+ * Records the input hashes of all root modules in the state file.
+ */
+void saveIncrementalState();
+
+#endif // LDC_DRIVER_INCREMENTAL_H
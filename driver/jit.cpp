@@ -0,0 +1,454 @@
+//===-- jit.cpp -----------------------------------------------------------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "driver/jit.h"
+#include "mars.h"
+#include "module.h"
+#include "gen/irstate.h"
+#include "gen/logger.h"
+#include "gen/modules.h"
+#include "gen/optimizer.h"
+#if LDC_LLVM_VER >= 308
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#endif
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if LDC_LLVM_VER >= 308
+/// The optimized modules to run, in the order they were generated.
+static std::vector<std::unique_ptr<llvm::Module>> jitModules;
+#endif
+
+void addJITModule(llvm::Module &m) {
+#if LDC_LLVM_VER >= 308
+  ldc_optimize_module(&m);
+  jitModules.push_back(llvm::CloneModule(&m));
+#else
+  llvm_unreachable("-run=jit requires LLVM 3.8+");
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+#if LDC_LLVM_VER >= 308
+static bool loadLibrary(const std::string &path) {
+  std::string errMsg;
+  if (llvm::sys::DynamicLibrary::LoadLibraryPermanently(path.c_str(),
+                                                        &errMsg)) {
+    IF_LOG Logger::println("Cannot load %s: %s", path.c_str(), errMsg.c_str());
+    return false;
+  }
+  IF_LOG Logger::println("Loaded %s", path.c_str());
+  return true;
+}
+
+/// Loads the shared library lib<name>.so for every -l<name> linker switch
+/// (which includes the default libraries), looking in the -L directories
+/// first. Libraries which cannot be loaded are skipped; the JIT reports the
+/// symbols which remain unresolved.
+static void loadLibraries() {
+  const char *ext = global.params.targetTriple.isOSDarwin() ? ".dylib" : ".so";
+
+  std::vector<llvm::StringRef> dirs;
+  std::vector<std::string> libs;
+  for (unsigned i = 0; i < global.params.linkswitches->dim; i++) {
+    llvm::StringRef p =
+        static_cast<const char *>(global.params.linkswitches->data[i]);
+    if (p.startswith("-L")) {
+      dirs.push_back(p.substr(2));
+    } else if (p.startswith("-l")) {
+      libs.push_back(("lib" + p.substr(2) + ext).str());
+    }
+  }
+  for (unsigned i = 0; i < global.params.libfiles->dim; i++) {
+    const char *p = static_cast<const char *>(global.params.libfiles->data[i]);
+    libs.push_back(p);
+  }
+
+  for (const auto &lib : libs) {
+    bool loaded = false;
+    if (!llvm::sys::path::is_absolute(lib)) {
+      for (auto dir : dirs) {
+        llvm::SmallString<128> path(dir);
+        llvm::sys::path::append(path, lib);
+        if (llvm::sys::fs::exists(path.str()) && loadLibrary(path.str())) {
+          loaded = true;
+          break;
+        }
+      }
+    }
+    if (!loaded) {
+      loadLibrary(lib);
+    }
+  }
+
+  // Also resolve symbols from the compiler process itself, e.g. the C library.
+  llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+}
+
+namespace {
+// GC functions of the shared druntime.
+void (*gcAddRange)(const void *p, size_t size, const void *ti);
+void (*gcRemoveRange)(const void *p);
+
+/// Whether druntime is initialized, i.e. the GC may be used.
+std::atomic<bool> druntimeRunning(false);
+
+/// The control variable LLVM emits for each emulated thread-local variable
+/// (__emutls_v.<name>), see __emutls_control in libgcc/compiler-rt.
+struct EmuTLSControl {
+  size_t size;
+  size_t align;
+  void *index;
+  const void *templ;
+};
+
+/// The control variables created for thread-local variables which aren't
+/// defined by the JIT'd code, but natively by a loaded library, mapped to the
+/// symbol name. Only written before the program runs.
+llvm::DenseMap<const EmuTLSControl *, std::string> externalTLS;
+
+/// The emulated thread-local variables of one thread. The blocks of the JIT'd
+/// variables are allocated on first access and registered with the GC, as they
+/// may be the only reference to GC memory.
+class EmuTLSBlocks {
+  llvm::DenseMap<const EmuTLSControl *, void *> blocks;
+
+public:
+  ~EmuTLSBlocks() {
+    for (auto &entry : blocks) {
+      if (externalTLS.count(entry.first)) {
+        continue;
+      }
+      // The main thread exits after druntime has been terminated.
+      if (druntimeRunning) {
+        gcRemoveRange(entry.second);
+      }
+#if defined(_MSC_VER)
+      _aligned_free(entry.second);
+#else
+      free(entry.second);
+#endif
+    }
+  }
+
+  void *get(const EmuTLSControl *control) {
+    void *&block = blocks[control];
+    if (block) {
+      return block;
+    }
+
+    auto it = externalTLS.find(control);
+    if (it != externalTLS.end()) {
+      // dlsym() returns the address of a TLS symbol for the calling thread.
+      block = llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(it->second);
+      if (!block) {
+        fprintf(stderr, "Error: thread-local variable %s not found\n",
+                it->second.c_str());
+        abort();
+      }
+      return block;
+    }
+
+    const size_t align = std::max(control->align, sizeof(void *));
+    const size_t size =
+        (std::max<size_t>(control->size, 1) + align - 1) / align * align;
+#if defined(_MSC_VER)
+    block = _aligned_malloc(size, align);
+#else
+    if (posix_memalign(&block, align, size) != 0) {
+      block = nullptr;
+    }
+#endif
+    if (!block) {
+      fprintf(stderr, "Error: out of memory for thread-local variables\n");
+      abort();
+    }
+    if (control->templ) {
+      memcpy(block, control->templ, control->size);
+    } else {
+      memset(block, 0, control->size);
+    }
+    gcAddRange(block, control->size, nullptr);
+    return block;
+  }
+};
+
+/// Replaces the libgcc/compiler-rt implementation for the JIT'd code.
+void *emutlsGetAddress(EmuTLSControl *control) {
+  static thread_local EmuTLSBlocks blocks;
+  return blocks.get(control);
+}
+
+/// Provides the emulated TLS support to the JIT'd code and keeps track of the
+/// writable data sections, which the GC has to scan.
+class JITMemoryManager : public llvm::SectionMemoryManager {
+  std::vector<std::pair<const void *, size_t>> dataSections;
+
+public:
+  uint8_t *allocateDataSection(uintptr_t size, unsigned alignment,
+                               unsigned sectionID,
+                               llvm::StringRef sectionName,
+                               bool isReadOnly) override {
+    uint8_t *p = SectionMemoryManager::allocateDataSection(
+        size, alignment, sectionID, sectionName, isReadOnly);
+    if (p && !isReadOnly) {
+      dataSections.push_back({p, size});
+    }
+    return p;
+  }
+
+  uint64_t getSymbolAddress(const std::string &name) override {
+    llvm::StringRef n = name;
+    if (global.params.targetTriple.isOSDarwin() && n.startswith("_")) {
+      n = n.substr(1);
+    }
+
+    if (n == "__emutls_get_address") {
+      return reinterpret_cast<uint64_t>(&emutlsGetAddress);
+    }
+
+    // A thread-local variable defined by a loaded library.
+    if (n.startswith("__emutls_v.")) {
+      auto control = new EmuTLSControl();
+      externalTLS[control] = n.substr(strlen("__emutls_v.")).str();
+      return reinterpret_cast<uint64_t>(control);
+    }
+
+    return SectionMemoryManager::getSymbolAddress(name);
+  }
+
+  void registerDataSections() {
+    for (const auto &s : dataSections) {
+      gcAddRange(s.first, s.second, nullptr);
+    }
+  }
+};
+
+// The ModuleInfo flags and the order of the optional fields following the
+// flags and index, see object.d in druntime and genmoduleinfo().
+const uint32_t MItlsctor = 8;
+const uint32_t MItlsdtor = 0x10;
+const uint32_t MIctor = 0x20;
+const uint32_t MIdtor = 0x40;
+const uint32_t MIunitTest = 0x200;
+
+struct ModuleInfoHeader {
+  uint32_t flags;
+  uint32_t index;
+};
+
+using ModuleFunction = void (*)();
+
+ModuleFunction getModuleFunction(const ModuleInfoHeader *mi, uint32_t flag) {
+  if (!(mi->flags & flag)) {
+    return nullptr;
+  }
+  auto field = reinterpret_cast<const ModuleFunction *>(mi + 1);
+  for (uint32_t f = MItlsctor; f != flag; f <<= 1) {
+    if (mi->flags & f) {
+      ++field;
+    }
+  }
+  return *field;
+}
+
+/// The D main function and the JIT'd ModuleInfos with the respective
+/// constructors or destructors, in constructor order.
+struct DSlice {
+  size_t length;
+  void *ptr;
+};
+int (*dMain)(DSlice args);
+JITMemoryManager *memoryManager;
+std::vector<const ModuleInfoHeader *> sharedCtorOrder;
+std::vector<const ModuleInfoHeader *> tlsCtorOrder;
+std::vector<const ModuleInfoHeader *> unitTestModules;
+
+void runModuleFunctions(const std::vector<const ModuleInfoHeader *> &order,
+                        uint32_t flag, bool reverse) {
+  for (size_t i = 0; i < order.size(); ++i) {
+    auto mi = order[reverse ? order.size() - 1 - i : i];
+    if (auto fn = getModuleFunction(mi, flag)) {
+      fn();
+    }
+  }
+}
+
+/// Passed to _d_run_main() instead of the D main function, so that the
+/// ModuleInfos of the JIT'd code, which druntime doesn't know about, are
+/// constructed after druntime has been initialized. Exceptions thrown by the
+/// D code propagate to _d_run_main().
+int jitMain(DSlice args) {
+  druntimeRunning = true;
+  memoryManager->registerDataSections();
+
+  runModuleFunctions(sharedCtorOrder, MIctor, false);
+  runModuleFunctions(tlsCtorOrder, MItlsctor, false);
+  runModuleFunctions(unitTestModules, MIunitTest, false);
+
+  const int status = dMain(args);
+
+  runModuleFunctions(tlsCtorOrder, MItlsdtor, true);
+  runModuleFunctions(sharedCtorOrder, MIdtor, true);
+  return status;
+}
+
+/// Looks up the ModuleInfos of the given modules in the JIT'd code and
+/// computes their constructor order.
+void collectModuleInfos(llvm::ExecutionEngine &engine,
+                        const std::vector<Module *> &modules) {
+  llvm::DenseMap<Module *, const ModuleInfoHeader *> moduleInfos;
+  for (auto m : modules) {
+    if (m->noModuleInfo) {
+      continue;
+    }
+    std::string name("_D");
+    name.append(mangle(m));
+    name.append("12__ModuleInfoZ");
+    if (uint64_t addr = engine.getGlobalValueAddress(name)) {
+      auto mi = reinterpret_cast<const ModuleInfoHeader *>(
+          static_cast<uintptr_t>(addr));
+      moduleInfos[m] = mi;
+      if (mi->flags & MIunitTest) {
+        unitTestModules.push_back(mi);
+      }
+    }
+  }
+
+  auto getOrder = [&](bool shared, uint32_t flags) {
+    auto hasCtors = [&](Module *m) {
+      auto it = moduleInfos.find(m);
+      return it != moduleInfos.end() && (it->second->flags & flags) != 0;
+    };
+    std::vector<const ModuleInfoHeader *> result;
+    for (auto m : getModuleCtorOrder(modules, shared, hasCtors)) {
+      result.push_back(moduleInfos[m]);
+    }
+    return result;
+  };
+  sharedCtorOrder = getOrder(true, MIctor | MIdtor);
+  tlsCtorOrder = getOrder(false, MItlsctor | MItlsdtor);
+}
+}
+#endif
+
+int runInProcess(const char *programName, const std::vector<std::string> &args,
+                 const std::vector<Module *> &modules) {
+#if LDC_LLVM_VER >= 308
+  Logger::println("*** Running program in-process ***");
+  assert(!jitModules.empty());
+
+  loadLibraries();
+
+  using RunMainFn = int (*)(int, char **, int (*)(DSlice));
+  auto runMain = reinterpret_cast<RunMainFn>(
+      llvm::sys::DynamicLibrary::SearchForAddressOfSymbol("_d_run_main"));
+  gcAddRange = reinterpret_cast<decltype(gcAddRange)>(
+      llvm::sys::DynamicLibrary::SearchForAddressOfSymbol("gc_addRange"));
+  gcRemoveRange = reinterpret_cast<decltype(gcRemoveRange)>(
+      llvm::sys::DynamicLibrary::SearchForAddressOfSymbol("gc_removeRange"));
+  if (!runMain || !gcAddRange || !gcRemoveRange) {
+    error(Loc(), "-run=jit requires druntime to be built as a shared library");
+    return EXIT_FAILURE;
+  }
+
+  // Only the backend of the compilation target has been initialized, which
+  // isn't necessarily the native one.
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  // MCJIT can't resolve native TLS relocations. The emulated TLS functions are
+  // provided by the memory manager.
+  llvm::TargetOptions targetOptions = gTargetMachine->Options;
+  targetOptions.EmulatedTLS = true;
+
+  auto mm = llvm::make_unique<JITMemoryManager>();
+  memoryManager = mm.get();
+
+  std::string errStr;
+  llvm::EngineBuilder builder(std::move(jitModules.front()));
+  builder.setEngineKind(llvm::EngineKind::JIT)
+      .setErrorStr(&errStr)
+      .setMCJITMemoryManager(std::move(mm))
+      .setTargetOptions(targetOptions)
+      .setOptLevel(codeGenOptLevel())
+      // The JIT code model allows the memory manager to place the code and
+      // data anywhere in the address space.
+      .setCodeModel(llvm::CodeModel::JITDefault);
+
+  // A dedicated target machine for the same target, which the execution
+  // engine takes ownership of.
+  llvm::SmallVector<std::string, 8> attrs;
+  llvm::SmallVector<llvm::StringRef, 8> features;
+  gTargetMachine->getTargetFeatureString().split(features, ",");
+  for (auto f : features) {
+    if (!f.empty()) {
+      attrs.push_back(f.str());
+    }
+  }
+  llvm::TargetMachine *jitTargetMachine = builder.selectTarget(
+      gTargetMachine->getTargetTriple(), "", gTargetMachine->getTargetCPU(),
+      attrs);
+  std::unique_ptr<llvm::ExecutionEngine> engine(
+      jitTargetMachine ? builder.create(jitTargetMachine) : nullptr);
+  if (!engine) {
+    error(Loc(), "failed to create JIT: %s", errStr.c_str());
+    return EXIT_FAILURE;
+  }
+
+  for (size_t i = 1; i < jitModules.size(); ++i) {
+    engine->addModule(std::move(jitModules[i]));
+  }
+  jitModules.clear();
+  engine->finalizeObject();
+
+  dMain = reinterpret_cast<decltype(dMain)>(
+      static_cast<uintptr_t>(engine->getFunctionAddress("_Dmain")));
+  if (!dMain) {
+    error(Loc(), "no D main function to run");
+    return EXIT_FAILURE;
+  }
+  collectModuleInfos(*engine, modules);
+  if (global.errors) {
+    return EXIT_FAILURE;
+  }
+
+  std::vector<char *> argv;
+  argv.reserve(args.size() + 2);
+  argv.push_back(const_cast<char *>(programName));
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  engine->runStaticConstructorsDestructors(false);
+  const int status =
+      runMain(static_cast<int>(argv.size() - 1), argv.data(), &jitMain);
+  druntimeRunning = false;
+  engine->runStaticConstructorsDestructors(true);
+  return status;
+#else
+  llvm_unreachable("-run=jit requires LLVM 3.8+");
+#endif
+}
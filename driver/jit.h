@@ -0,0 +1,50 @@
+//===-- driver/jit.h - In-process execution for -run=jit --------*- C++ -*-===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Runs the generated code in-process using MCJIT instead of writing object
+// files and linking an executable. The D runtime and all other libraries are
+// loaded as shared libraries.
+//
+// The JIT'd code isn't part of any DSO, so druntime doesn't know about its
+// ModuleInfos. Instead of the D main function, _d_run_main() calls a wrapper
+// which registers the writable data sections with the GC and runs the module
+// constructors, the unittests and the module destructors of the JIT'd modules
+// around the D main function. Thread-local variables are emulated; the blocks
+// are allocated per thread and registered with the GC as well. The
+// thread-local module constructors only run in the main thread, and a failing
+// unittest aborts the program like an uncaught exception in main.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LDC_DRIVER_JIT_H
+#define LDC_DRIVER_JIT_H
+
+#include <string>
+#include <vector>
+
+class Module;
+namespace llvm {
+class Module;
+}
+
+/**
+ * Optimizes the given module and keeps a copy of it for runInProcess().
+ */
+void addJITModule(llvm::Module &m);
+
+/**
+ * Loads the libraries to link against and runs the D main function of the
+ * modules passed to addJITModule() via druntime, constructing the ModuleInfos
+ * of the given root modules.
+ * @return the return status of the program.
+ */
+int runInProcess(const char *programName, const std::vector<std::string> &args,
+                 const std::vector<Module *> &modules);
+
+#endif // LDC_DRIVER_JIT_H
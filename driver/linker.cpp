@@ -18,7 +18,12 @@
 #include "gen/logger.h"
 #include "gen/optimizer.h"
 #include "gen/programs.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Triple.h"
+#if LDC_LLVM_VER >= 309
+#include "llvm/Object/ArchiveWriter.h"
+#endif
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Path.h"
@@ -28,6 +33,11 @@
 #include <Windows.h>
 #endif
 
+static llvm::cl::opt<bool> externalArchiver(
+    "external-archiver", llvm::cl::Hidden, llvm::cl::ZeroOrMore,
+    llvm::cl::desc("Create static libraries by writing object files and "
+                   "invoking the system archiver"));
+
 //////////////////////////////////////////////////////////////////////////////
 
 static bool endsWith(const std::string &str, const std::string &end) {
@@ -147,6 +157,19 @@ static int linkObjToBinaryGcc(bool sharedLib, bool fullyStatic) {
     args.push_back("-fsanitize=thread");
   }
 
+#if LDC_LLVM_VER >= 400
+  // Link the XRay runtime, which sets up the sled table before the D runtime
+  // is initialized. Only clang knows where to find it.
+  if (opts::instrumentXRay) {
+    if (!llvm::sys::path::filename(gcc).contains("clang")) {
+      error(Loc(), "-finstrument-functions-xray requires clang as linker "
+                   "driver, e.g. via the CC environment variable");
+      return -1;
+    }
+    args.push_back("-fxray-instrument");
+  }
+#endif
+
   // additional linker switches
   for (unsigned i = 0; i < global.params.linkswitches->dim; i++) {
     const char *p =
@@ -613,15 +636,76 @@ int linkObjToBinary(bool sharedLib, bool fullyStatic) {
 
 //////////////////////////////////////////////////////////////////////////////
 
+#if LDC_LLVM_VER >= 309
+/// The object code of the modules compiled into a static library, by object
+/// file name.
+static llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> inMemoryObjects;
+#endif
+
+bool archiveInMemory() {
+#if LDC_LLVM_VER >= 309
+  // Incremental builds need the object files on disk to reuse them.
+  return opts::createStaticLib && !externalArchiver &&
+         opts::incrementalStateFile.empty() &&
+         !global.params.targetTriple.isWindowsMSVCEnvironment();
+#else
+  return false;
+#endif
+}
+
+void addInMemoryObject(const char *filename, llvm::StringRef objectCode) {
+#if LDC_LLVM_VER >= 309
+  assert(archiveInMemory());
+  inMemoryObjects[filename] = llvm::MemoryBuffer::getMemBufferCopy(
+      objectCode, llvm::sys::path::filename(filename));
+#else
+  llvm_unreachable("In-memory archives require LLVM 3.9+");
+#endif
+}
+
+#if LDC_LLVM_VER >= 309
+/// Writes the archive using LLVM's archive writer. Object files that were not
+/// compiled in memory (i.e. given on the command line) are read from disk.
+static int writeArchiveInMemory(const std::string &libName) {
+  std::vector<llvm::NewArchiveMember> members;
+  for (unsigned i = 0; i < global.params.objfiles->dim; i++) {
+    const char *p = static_cast<const char *>(global.params.objfiles->data[i]);
+    auto it = inMemoryObjects.find(p);
+    if (it != inMemoryObjects.end()) {
+      members.push_back(llvm::NewArchiveMember(it->second->getMemBufferRef()));
+      continue;
+    }
+
+    auto member = llvm::NewArchiveMember::getFile(p, /*Deterministic=*/true);
+    if (!member) {
+      error(Loc(), "cannot read object file '%s': %s", p,
+            llvm::errorToErrorCode(member.takeError()).message().c_str());
+      return EXIT_FAILURE;
+    }
+    members.push_back(std::move(*member));
+  }
+
+  const auto kind = global.params.targetTriple.isOSDarwin()
+                        ? llvm::object::Archive::K_BSD
+                        : llvm::object::Archive::K_GNU;
+  auto result = llvm::writeArchive(libName, members, /*WriteSymtab=*/true,
+                                   kind, /*Deterministic=*/true,
+                                   /*Thin=*/false);
+  if (result.second) {
+    error(Loc(), "cannot write static library '%s': %s", libName.c_str(),
+          result.second.message().c_str());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+#endif
+
 int createStaticLibrary() {
   Logger::println("*** Creating static library ***");
 
   const bool isTargetWindows =
       global.params.targetTriple.isWindowsMSVCEnvironment();
 
-  // find archiver
-  std::string tool(isTargetWindows ? "lib.exe" : getArchiver());
-
   // build arguments
   std::vector<std::string> args;
 
@@ -679,6 +763,15 @@ int createStaticLibrary() {
   // create path to the library
   CreateDirectoryOnDisk(libName);
 
+#if LDC_LLVM_VER >= 309
+  if (archiveInMemory()) {
+    return writeArchiveInMemory(libName);
+  }
+#endif
+
+  // find archiver
+  std::string tool(isTargetWindows ? "lib.exe" : getArchiver());
+
   // try to call archiver
   int exitCode;
   if (isTargetWindows) {
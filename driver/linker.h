@@ -15,6 +15,8 @@
 #ifndef LDC_DRIVER_LINKER_H
 #define LDC_DRIVER_LINKER_H
 
+#include "llvm/ADT/StringRef.h"
+
 /**
  * Link an executable only from object files.
  * @return 0 on success.
@@ -27,6 +29,18 @@ int linkObjToBinary(bool sharedLib, bool fullyStatic);
  */
 int createStaticLibrary();
 
+/**
+ * Whether the object code for a static library is kept in memory and
+ * archived by createStaticLibrary without going through object files.
+ */
+bool archiveInMemory();
+
+/**
+ * Registers the object code for the given object file name, to be archived
+ * instead of reading the file. Only valid if archiveInMemory() is true.
+ */
+void addInMemoryObject(const char *filename, llvm::StringRef objectCode);
+
 /**
  * Delete the executable that was previously linked with linkObjToBinary.
  */
@@ -24,6 +24,8 @@
 #include "driver/codegenerator.h"
 #include "driver/configfile.h"
 #include "driver/exe_path.h"
+#include "driver/incremental.h"
+#include "driver/jit.h"
 #include "driver/ldc-version.h"
 #include "driver/linker.h"
 #include "driver/targetmachine.h"
@@ -34,6 +36,7 @@
 #include "gen/llvmhelpers.h"
 #include "gen/logger.h"
 #include "gen/metadata.h"
+#include "gen/modules.h"
 #include "gen/optimizer.h"
 #include "gen/passes/Passes.h"
 #include "gen/runtime.h"
@@ -53,6 +56,7 @@
 #include "llvm/LinkAllIR.h"
 #include "llvm/IR/LLVMContext.h"
 #include <assert.h>
+#include <chrono>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -72,6 +76,11 @@ using namespace opts;
 
 extern void getenv_setargv(const char *envvar, int *pargc, char ***pargv);
 
+static cl::opt<bool>
+    startupBenchmark("startup-benchmark", cl::ZeroOrMore, cl::Hidden,
+                     cl::desc("Print the time until the first module is "
+                              "parsed, and exit"));
+
 static cl::opt<bool>
     noDefaultLib("nodefaultlib",
                  cl::desc("Don't add a default library for linking implicitly"),
@@ -340,6 +349,11 @@ static void parseCommandLine(int argc, char **argv, Strings &sourceFiles,
                               const_cast<char **>(final_args.data()),
                               "LDC - the LLVM D compiler\n");
 
+  if (!incrementalStateFile.empty()) {
+    global.params.hashInputs = true;
+    loadIncrementalState(final_args);
+  }
+
   helpOnly = mCPU == "help" ||
              (std::find(mAttrs.begin(), mAttrs.end(), "help") != mAttrs.end());
 
@@ -403,6 +417,7 @@ static void parseCommandLine(int argc, char **argv, Strings &sourceFiles,
 
   templateLinkage = opts::linkonceTemplates ? LLGlobalValue::LinkOnceODRLinkage
                                             : LLGlobalValue::WeakODRLinkage;
+  defineTemplatesInOwnerOnly = opts::singleOwnerTemplates;
 
   if (global.params.run || !runargs.empty()) {
     // FIXME: how to properly detect the presence of a PositionalEatsArgs
@@ -412,6 +427,15 @@ static void parseCommandLine(int argc, char **argv, Strings &sourceFiles,
     // NOTE: Hacked around it by detecting -run in getenv_setargv(), where
     // we're looking for it anyway, and pre-setting the flag...
     global.params.run = true;
+    if (!runargs.empty() && runargs[0] == "jit") {
+#if LDC_LLVM_VER >= 308
+      runJIT = true;
+#else
+      error(Loc(), "-run=jit requires LDC to be built against LLVM 3.8+");
+#endif
+      runargs.erase(runargs.begin());
+      gCompileForJIT = runJIT;
+    }
     if (!runargs.empty()) {
       char const *name = runargs[0].c_str();
       char const *ext = FileName::ext(name);
@@ -519,6 +543,34 @@ static void parseCommandLine(int argc, char **argv, Strings &sourceFiles,
     error(Loc(), "-lib and -shared switches cannot be used together");
   }
 
+  if (!incrementalStateFile.empty() && (singleObj || runJIT)) {
+    error(Loc(), "-incremental cannot be used with -singleobj or -run=jit");
+  }
+
+  // Only the first partition would be reused.
+  if (!incrementalStateFile.empty() && codegenPartitions > 1) {
+    error(Loc(), "-incremental cannot be used with -codegen-partitions");
+  }
+
+  // The owner must keep its definitions even if it doesn't use them itself,
+  // and which module owns an instance depends on all the root modules.
+  if (singleOwnerTemplates &&
+      (linkonceTemplates || singleObj || !incrementalStateFile.empty())) {
+    error(Loc(), "-single-owner-templates cannot be used with "
+                 "-linkonce-templates, -singleobj or -incremental");
+  }
+
+  // The class hierarchy is only complete if all modules are compiled into
+  // the same object file.
+  if (wholeProgramDevirt && !singleObj) {
+    error(Loc(), "-whole-program-devirt requires -singleobj");
+  }
+
+  // Other object files could still refer to the stripped symbols.
+  if (stripDeadTypeInfo && !singleObj) {
+    error(Loc(), "-strip-dead-typeinfo requires -singleobj");
+  }
+
 #if LDC_LLVM_VER >= 309
   if (createSharedLib && !mRelocModel.getNumOccurrences()) {
 #else
@@ -876,6 +928,12 @@ static void registerPredefinedVersions() {
     VersionCondition::addPredefinedGlobalIdent("LDC_ThreadSanitizer");
   }
 
+#if LDC_LLVM_VER >= 400
+  if (opts::instrumentXRay) {
+    VersionCondition::addPredefinedGlobalIdent("LDC_XRay");
+  }
+#endif
+
 // Expose LLVM version to runtime
 #define STR(x) #x
 #define XSTR(x) STR(x)
@@ -906,16 +964,16 @@ static void dumpPredefinedVersions() {
 ///
 /// This (ugly) piece of code has been taken from DMD's mars.c and should be
 /// kept in sync with the former.
+///
+/// The description is written module by module instead of being built in
+/// memory as a whole, so that the memory use doesn't grow with the number of
+/// modules.
 static void emitJson(Modules &modules) {
-  OutBuffer buf;
-  json_generate(&buf, &modules);
-
-  // Write buf to file
   const char *name = global.params.jsonfilename;
 
   if (name && name[0] == '-' &&
       name[1] == 0) { // Write to stdout; assume it succeeds
-    (void)fwrite(buf.data, 1, buf.offset, stdout);
+    json_generate(stdout, &modules, jsonRecords);
   } else {
     /* The filename generation code here should be harmonized with
      * Module::setOutfile()
@@ -937,11 +995,17 @@ static void emitJson(Modules &modules) {
 
     ensurePathToNameExists(Loc(), jsonfilename);
 
-    auto jsonfile = new File(jsonfilename);
-
-    jsonfile->setbuffer(buf.data, buf.offset);
-    jsonfile->ref = 1;
-    writeFile(Loc(), jsonfile);
+    FILE *out = fopen(jsonfilename, "wb");
+    if (!out) {
+      error(Loc(), "Error writing file '%s'", jsonfilename);
+      fatal();
+    }
+    json_generate(out, &modules, jsonRecords);
+    const bool writeError = ferror(out) != 0;
+    if (fclose(out) != 0 || writeError) {
+      error(Loc(), "Error writing file '%s'", jsonfilename);
+      fatal();
+    }
   }
 }
 
@@ -959,6 +1023,8 @@ static bool validiOSArch(const std::string &iosArch) {
 }
 
 int main(int argc, char **argv) {
+  const auto startTime = std::chrono::steady_clock::now();
+
   // stack trace on signals
 #if LDC_LLVM_VER >= 309
   llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
@@ -973,13 +1039,10 @@ int main(int argc, char **argv) {
   global.ldc_version = ldc::ldc_version;
   global.llvm_version = ldc::llvm_version;
 
-  // Initialize LLVM before parsing the command line so that --version shows
-  // registered targets.
+  // Register the targets before parsing the command line so that --version
+  // shows them. Only the backend of the selected target is initialized, once
+  // the TargetMachine is set up.
   llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargets();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmPrinters();
-  llvm::InitializeAllAsmParsers();
 
   initializePasses();
 
@@ -1056,6 +1119,40 @@ int main(int argc, char **argv) {
     global.params.is64bit = triple.isArch64Bit();
   }
 
+#if LDC_LLVM_VER >= 400
+  if (opts::instrumentXRay) {
+    const llvm::Triple &triple = global.params.targetTriple;
+    const auto arch = triple.getArch();
+    if (!triple.isOSLinux() ||
+        (arch != llvm::Triple::x86_64 && arch != llvm::Triple::arm &&
+         arch != llvm::Triple::thumb && arch != llvm::Triple::aarch64)) {
+      error(Loc(), "-finstrument-functions-xray is not supported for %s",
+            triple.str().c_str());
+      fatal();
+    }
+  }
+#endif
+
+  if (opts::debugTypesSection) {
+    const llvm::Triple &triple = global.params.targetTriple;
+    if (!triple.isOSBinFormatELF()) {
+      error(Loc(), "-fdebug-types-section is not supported for %s",
+            triple.str().c_str());
+      fatal();
+    }
+    // Type units are emitted by the DWARF writer if this LLVM option is set.
+#if LDC_LLVM_VER >= 307
+    llvm::StringMap<cl::Option *> &map = cl::getRegisteredOptions();
+#else
+    llvm::StringMap<cl::Option *> map;
+    cl::getRegisteredOptions(map);
+#endif
+    auto i = map.find("generate-type-units");
+    if (i != map.end()) {
+      i->getValue()->addOccurrence(0, "generate-type-units", "true");
+    }
+  }
+
   // allocate the target abi
   gABI = TargetABI::getTarget();
 
@@ -1262,8 +1359,19 @@ int main(int argc, char **argv) {
     }
 
     m->parse(global.params.doDocComments);
+
+    if (startupBenchmark) {
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - startTime;
+      fprintf(global.stdmsg, "time to first parse: %.3f ms\n",
+              elapsed.count());
+      return EXIT_SUCCESS;
+    }
+
     m->buildTargetFiles(singleObj, createSharedLib || createStaticLib);
-    m->deleteObjFile();
+    if (incrementalStateFile.empty()) {
+      m->deleteObjFile();
+    }
     if (m->isDocFile) {
       gendocfile(m);
 
@@ -1359,8 +1467,20 @@ int main(int argc, char **argv) {
   if (global.params.obj && !modules.empty()) {
     ldc::CodeGenerator cg(getGlobalContext(), singleObj);
 
+    if (!incrementalStateFile.empty()) {
+      planIncrementalBuild(modules);
+    }
+
     for (unsigned i = 0; i < modules.dim; i++) {
       Module *const m = modules[i];
+      if (canReuseObjectFile(m)) {
+        if (global.params.verbose) {
+          fprintf(global.stdmsg, "reuse     %s\n", m->toChars());
+        }
+        global.params.objfiles->push(m->objfile->name->str);
+        continue;
+      }
+
       if (global.params.verbose) {
         fprintf(global.stdmsg, "code      %s\n", m->toChars());
       }
@@ -1371,6 +1491,10 @@ int main(int argc, char **argv) {
         fatal();
       }
     }
+
+    if (!incrementalStateFile.empty()) {
+      saveIncrementalState();
+    }
   }
 
   // Generate DDoc output files.
@@ -1385,6 +1509,14 @@ int main(int argc, char **argv) {
     emitJson(modules);
   }
 
+  // Run the program in-process, without writing an executable.
+  if (runJIT && !global.errors && !modules.empty()) {
+    return runInProcess(global.params.exefile ? global.params.exefile
+                                              : modules[0]->srcfile->toChars(),
+                        runargs,
+                        std::vector<Module *>(modules.begin(), modules.end()));
+  }
+
   freeRuntime();
   llvm::llvm_shutdown();
 
@@ -25,6 +25,7 @@
 #include "llvm/Target/TargetOptions.h"
 #include "mars.h"
 #include "gen/logger.h"
+#include <string.h>
 
 #if LDC_LLVM_VER >= 307
 #include "driver/cl_options.h"
@@ -362,6 +363,41 @@ static void addMipsABI(const llvm::Triple &triple,
 }
 #endif
 
+/// Initializes the LLVM backend providing the given (registered) target,
+/// i.e. its TargetMachine, MC layer, asm printer and asm parser. The other
+/// backends are left alone, as initializing all of them noticeably slows down
+/// compiler startup.
+static void initializeBackend(const llvm::Target *target) {
+  // Each backend registers the TargetMachine for all of its targets, so
+  // initialize them in turn until the one we are looking for is found.
+  const char *backend = nullptr;
+#define LLVM_TARGET(TargetName)                                                \
+  if (!backend) {                                                              \
+    LLVMInitialize##TargetName##Target();                                      \
+    if (target->hasTargetMachine()) {                                          \
+      backend = #TargetName;                                                   \
+      LLVMInitialize##TargetName##TargetMC();                                  \
+    }                                                                          \
+  }
+#include "llvm/Config/Targets.def"
+
+  if (!backend) {
+    return;
+  }
+
+#define LLVM_ASM_PRINTER(TargetName)                                           \
+  if (strcmp(backend, #TargetName) == 0) {                                     \
+    LLVMInitialize##TargetName##AsmPrinter();                                  \
+  }
+#include "llvm/Config/AsmPrinters.def"
+
+#define LLVM_ASM_PARSER(TargetName)                                            \
+  if (strcmp(backend, #TargetName) == 0) {                                     \
+    LLVMInitialize##TargetName##AsmParser();                                   \
+  }
+#include "llvm/Config/AsmParsers.def"
+}
+
 /// Looks up a target based on an arch name and a target triple.
 ///
 /// If the arch name is non-empty, then the lookup is done by arch. Otherwise,
@@ -485,6 +521,7 @@ llvm::TargetMachine *createTargetMachine(
     error(Loc(), "%s", errMsg.c_str());
     fatal();
   }
+  initializeBackend(target);
 
   // Package up features to be passed to target/subtarget.
   llvm::SubtargetFeatures features;
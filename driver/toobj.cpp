@@ -8,13 +8,17 @@
 //===----------------------------------------------------------------------===//
 
 #include "driver/toobj.h"
+#include "driver/cl_options.h"
+#include "driver/linker.h"
 #include "driver/targetmachine.h"
 #include "driver/tool.h"
 #include "gen/irstate.h"
 #include "gen/logger.h"
 #include "gen/optimizer.h"
 #include "gen/programs.h"
+#include "rmem.h"
 #include "llvm/IR/AssemblyAnnotationWriter.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #if LDC_LLVM_VER >= 307
@@ -25,7 +29,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/Threading.h"
 #if LDC_LLVM_VER >= 307
 #include "llvm/Support/Path.h"
 #endif
@@ -37,16 +43,37 @@
 #include "llvm/Target/TargetSubtargetInfo.h"
 #endif
 #include "llvm/IR/Module.h"
+#if LDC_LLVM_VER >= 309
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#endif
 #include <cstddef>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 static llvm::cl::opt<bool>
     NoIntegratedAssembler("no-integrated-as", llvm::cl::Hidden,
                           llvm::cl::desc("Disable integrated assembler"));
 
+#if LDC_LLVM_VER >= 307
+using CodegenOStream = llvm::raw_pwrite_stream;
+#else
+using CodegenOStream = llvm::raw_fd_ostream;
+#endif
+
+#if LDC_LLVM_VER >= 306
+using ErrorInfo = std::error_code;
+#define ERRORINFO_STRING(errinfo) errinfo.message().c_str()
+#else
+using ErrorInfo = std::string;
+#define ERRORINFO_STRING(errinfo) errinfo.c_str()
+#endif
+
 // based on llc code, University of Illinois Open Source License
 static void codegenModule(llvm::TargetMachine &Target, llvm::Module &m,
-                          llvm::raw_fd_ostream &out,
+                          CodegenOStream &out,
                           llvm::TargetMachine::CodeGenFileType fileType) {
   using namespace llvm;
 
@@ -95,6 +122,250 @@ static void codegenModule(llvm::TargetMachine &Target, llvm::Module &m,
   Passes.run(m);
 }
 
+#if LDC_LLVM_VER >= 307
+/// Creates a copy of the global target machine, for generating code on
+/// another thread.
+static std::unique_ptr<llvm::TargetMachine> cloneTargetMachine() {
+  const llvm::TargetMachine &TM = *gTargetMachine;
+  return std::unique_ptr<llvm::TargetMachine>(
+      TM.getTarget().createTargetMachine(
+          TM.getTargetTriple().str(), TM.getTargetCPU(),
+          TM.getTargetFeatureString(), TM.Options, TM.getRelocationModel(),
+          TM.getCodeModel(), TM.getOptLevel()));
+}
+
+/// Generates native assembly for a module given as bitcode. The module is
+/// loaded into a context of its own, so that this can run in parallel to the
+/// code generation for the original module.
+static std::string codegenAssemblyFromBitcode(const std::string &bitcode,
+                                              const std::string &path) {
+  llvm::LLVMContext context;
+  auto module =
+      llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, path), context);
+  if (!module) {
+    return "cannot read back module for native asm: " +
+           module.getError().message();
+  }
+
+  std::error_code errinfo;
+  llvm::raw_fd_ostream out(path, errinfo, llvm::sys::fs::F_None);
+  if (errinfo) {
+    return "cannot write native asm: " + errinfo.message();
+  }
+  codegenModule(*cloneTargetMachine(), **module, out,
+                llvm::TargetMachine::CGFT_AssemblyFile);
+  return "";
+}
+#endif
+
+#if LDC_LLVM_VER >= 309
+/// Returns whether the global is part of the ModuleInfo registration for the
+/// DSO registry, i.e. in one of the .minfo* sections or one of the ldc.dso_*
+/// helpers.
+static bool isModuleRegistration(const llvm::GlobalObject &go) {
+  return llvm::StringRef(go.getSection()).startswith(".minfo") ||
+         go.getName().startswith("ldc.dso_");
+}
+
+/// Generates object code for the partitions of the module in parallel, using
+/// a separate target machine and context for each thread.
+///
+/// The ModuleInfo registration is kept together in the first partition, as
+/// the bracketing _minfo_beg/_minfo_end symbols only enclose the ModuleInfo
+/// references if the sections are emitted in order into one object file.
+static void
+codegenModuleParallel(llvm::Module &m,
+                      llvm::ArrayRef<llvm::raw_pwrite_stream *> outs) {
+  // SplitModule() consumes the module, which is owned by the IRState.
+  auto clone = llvm::CloneModule(&m);
+
+  // Globals in a comdat are assigned to the same partition, so temporarily
+  // put the registration into one.
+  const char *const comdatName = "ldc.module_registration";
+  llvm::Comdat *registration = clone->getOrInsertComdat(comdatName);
+  auto addToRegistration = [registration](llvm::GlobalObject &go) {
+    if (!go.isDeclaration() && !go.getComdat() && isModuleRegistration(go)) {
+      go.setComdat(registration);
+    }
+  };
+  for (auto &f : clone->functions()) {
+    addToRegistration(f);
+  }
+  for (auto &gv : clone->globals()) {
+    addToRegistration(gv);
+  }
+
+  // Each partition is handed to its thread as bitcode, as LLVM contexts are
+  // not thread-safe.
+  std::vector<llvm::SmallString<0>> bitcode;
+  size_t registrationIndex = 0;
+  // Local symbols are kept in the partition of their users instead of being
+  // externalized, as they could clash with other object files.
+  llvm::SplitModule(std::move(clone), outs.size(),
+                    [&](std::unique_ptr<llvm::Module> part) {
+                      bool hasRegistration = false;
+                      auto removeComdat = [&](llvm::GlobalObject &go) {
+                        auto c = go.getComdat();
+                        if (c && c->getName() == comdatName) {
+                          go.setComdat(nullptr);
+                          hasRegistration = true;
+                        }
+                      };
+                      for (auto &f : part->functions()) {
+                        removeComdat(f);
+                      }
+                      for (auto &gv : part->globals()) {
+                        removeComdat(gv);
+                      }
+                      part->getComdatSymbolTable().erase(comdatName);
+                      if (hasRegistration) {
+                        registrationIndex = bitcode.size();
+                      }
+
+                      bitcode.emplace_back();
+                      llvm::raw_svector_ostream bos(bitcode.back());
+                      llvm::WriteBitcodeToFile(part.get(), bos);
+                    },
+                    /*PreserveLocals=*/true);
+  std::swap(bitcode[0], bitcode[registrationIndex]);
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < outs.size(); ++i) {
+    threads.emplace_back([&bitcode, &outs, i]() {
+      llvm::LLVMContext context;
+      auto part = llvm::parseBitcodeFile(
+          llvm::MemoryBufferRef(bitcode[i].str(), "<partition>"), context);
+      if (!part) {
+        llvm::report_fatal_error("cannot read back module partition");
+      }
+      codegenModule(*cloneTargetMachine(), **part, *outs[i],
+                    llvm::TargetMachine::CGFT_ObjectFile);
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+#endif
+
+namespace {
+/// Runs the jobs writing secondary output files on background threads, so
+/// that they overlap with the machine code generation. Errors are collected
+/// and reported once all jobs have finished, as the diagnostics machinery is
+/// not thread-safe.
+class OutputJobs {
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::vector<std::string> errors;
+
+public:
+  /// Runs the given job, which returns an error message on failure and an
+  /// empty string otherwise.
+  template <typename Job> void run(Job job) {
+    threads.emplace_back([this, job]() {
+      std::string msg = job();
+      if (!msg.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        errors.push_back(msg);
+      }
+    });
+  }
+
+  /// Writes the given data to a file.
+  void writeFile(const std::string &path, std::shared_ptr<std::string> data,
+                 const char *kind) {
+    run([path, data, kind]() {
+      ErrorInfo errinfo;
+      llvm::raw_fd_ostream os(path.c_str(), errinfo, llvm::sys::fs::F_None);
+      if (os.has_error()) {
+        os.clear_error();
+        return std::string("cannot write ") + kind + " file '" + path +
+               "': " + ERRORINFO_STRING(errinfo);
+      }
+      os << *data;
+      os.close();
+      if (os.has_error()) {
+        os.clear_error();
+        return std::string("error writing ") + kind + " file '" + path + "'";
+      }
+      return std::string();
+    });
+  }
+
+  /// Waits for all jobs and aborts compilation if any of them failed.
+  void wait() {
+    for (auto &t : threads) {
+      t.join();
+    }
+    threads.clear();
+    for (const auto &msg : errors) {
+      error(Loc(), "%s", msg.c_str());
+    }
+    if (!errors.empty()) {
+      fatal();
+    }
+  }
+
+  ~OutputJobs() { assert(threads.empty() && "output jobs not waited for"); }
+};
+}
+
+/// Emits the object code for the module as codegenPartitions object files,
+/// the first one being the given file. The others are added to the object
+/// files to link.
+static void writeObjectPartitions(llvm::Module &m,
+                                  const std::string &filename) {
+#if LDC_LLVM_VER >= 309
+  const unsigned n = codegenPartitions;
+  std::vector<std::string> filenames(1, filename);
+  for (unsigned i = 1; i < n; ++i) {
+    llvm::SmallString<128> path(filename);
+    llvm::sys::path::replace_extension(
+        path, llvm::Twine(i) + llvm::sys::path::extension(filename));
+    filenames.push_back(path.str());
+  }
+
+  std::vector<llvm::raw_pwrite_stream *> outs;
+  if (archiveInMemory()) {
+    Logger::println("Generating object code for: %s (%u partitions)\n",
+                    filename.c_str(), n);
+    std::vector<llvm::SmallString<0>> objectCode(n);
+    std::vector<std::unique_ptr<llvm::raw_svector_ostream>> streams;
+    for (unsigned i = 0; i < n; ++i) {
+      streams.emplace_back(new llvm::raw_svector_ostream(objectCode[i]));
+      outs.push_back(streams.back().get());
+    }
+    codegenModuleParallel(m, outs);
+    for (unsigned i = 0; i < n; ++i) {
+      addInMemoryObject(filenames[i].c_str(), objectCode[i]);
+    }
+  } else {
+    Logger::println("Writing object file to: %s (%u partitions)\n",
+                    filename.c_str(), n);
+    std::vector<std::unique_ptr<llvm::raw_fd_ostream>> streams;
+    for (const auto &name : filenames) {
+      std::error_code errinfo;
+      streams.emplace_back(
+          new llvm::raw_fd_ostream(name, errinfo, llvm::sys::fs::F_None));
+      if (errinfo) {
+        error(Loc(), "cannot write object file: %s", errinfo.message().c_str());
+        fatal();
+      }
+      outs.push_back(streams.back().get());
+    }
+    codegenModuleParallel(m, outs);
+  }
+
+  for (unsigned i = 1; i < n; ++i) {
+    global.params.objfiles->push(mem.xstrdup(filenames[i].c_str()));
+  }
+#else
+  error(Loc(), "-codegen-partitions requires LDC to be built against LLVM "
+               "3.9+");
+  fatal();
+#endif
+}
+
 static void assemble(const std::string &asmpath, const std::string &objpath) {
   std::vector<std::string> args;
   args.push_back("-O3");
@@ -345,30 +616,38 @@ void writeModule(llvm::Module *m, std::string filename) {
       (NoIntegratedAssembler ||
        global.params.targetTriple.getOS() == llvm::Triple::AIX);
 
+  // If both native assembly and an object file are requested, the assembly is
+  // generated on another thread from a copy of the module read back from
+  // bitcode, while this thread generates the object code.
+  bool const codegenAsmInParallel =
+#if LDC_LLVM_VER >= 307
+      global.params.output_s && global.params.output_o &&
+      !assembleExternally && llvm::llvm_is_multithreaded();
+#else
+      false;
+#endif
+
   // eventually do our own path stuff, dmd's is a bit strange.
   using LLPath = llvm::SmallString<128>;
 
-#if LDC_LLVM_VER >= 306
-  using ErrorInfo = std::error_code;
-#define ERRORINFO_STRING(errinfo) errinfo.message().c_str()
-#else
-  using ErrorInfo = std::string;
-#define ERRORINFO_STRING(errinfo) errinfo.c_str()
-#endif
+  // The bitcode and IR outputs are serialized to memory first, as code
+  // generation modifies the module, and written to disk in the background.
+  OutputJobs jobs;
+
+  std::shared_ptr<std::string> bitcode;
+  if (global.params.output_bc || codegenAsmInParallel) {
+    bitcode = std::make_shared<std::string>();
+    llvm::raw_string_ostream bos(*bitcode);
+    llvm::WriteBitcodeToFile(m, bos);
+    bos.flush();
+  }
 
   // write LLVM bitcode
   if (global.params.output_bc) {
     LLPath bcpath(filename);
     llvm::sys::path::replace_extension(bcpath, global.bc_ext);
     Logger::println("Writing LLVM bitcode to: %s\n", bcpath.c_str());
-    ErrorInfo errinfo;
-    llvm::raw_fd_ostream bos(bcpath.c_str(), errinfo, llvm::sys::fs::F_None);
-    if (bos.has_error()) {
-      error(Loc(), "cannot write LLVM bitcode file '%s': %s", bcpath.c_str(),
-            ERRORINFO_STRING(errinfo));
-      fatal();
-    }
-    llvm::WriteBitcodeToFile(m, bos);
+    jobs.writeFile(bcpath.str(), bitcode, "LLVM bitcode");
   }
 
   // write LLVM IR
@@ -376,19 +655,27 @@ void writeModule(llvm::Module *m, std::string filename) {
     LLPath llpath(filename);
     llvm::sys::path::replace_extension(llpath, global.ll_ext);
     Logger::println("Writing LLVM asm to: %s\n", llpath.c_str());
-    ErrorInfo errinfo;
-    llvm::raw_fd_ostream aos(llpath.c_str(), errinfo, llvm::sys::fs::F_None);
-    if (aos.has_error()) {
-      error(Loc(), "cannot write LLVM asm file '%s': %s", llpath.c_str(),
-            ERRORINFO_STRING(errinfo));
-      fatal();
+    auto text = std::make_shared<std::string>();
+    {
+      llvm::raw_string_ostream aos(*text);
+      AssemblyAnnotator annotator;
+      m->print(aos, &annotator);
     }
-    AssemblyAnnotator annotator;
-    m->print(aos, &annotator);
+    jobs.writeFile(llpath.str(), text, "LLVM asm");
   }
 
   // write native assembly
-  if (global.params.output_s || assembleExternally) {
+  if (codegenAsmInParallel) {
+#if LDC_LLVM_VER >= 307
+    LLPath spath(filename);
+    llvm::sys::path::replace_extension(spath, global.s_ext);
+    Logger::println("Writing native asm to: %s\n", spath.c_str());
+    std::string path = spath.str();
+    jobs.run([bitcode, path]() {
+      return codegenAssemblyFromBitcode(*bitcode, path);
+    });
+#endif
+  } else if (global.params.output_s || assembleExternally) {
     LLPath spath(filename);
     llvm::sys::path::replace_extension(spath, global.s_ext);
     if (!global.params.output_s) {
@@ -422,7 +709,21 @@ void writeModule(llvm::Module *m, std::string filename) {
     }
   }
 
-  if (global.params.output_o && !assembleExternally) {
+  if (global.params.output_o && !assembleExternally && codegenPartitions > 1) {
+    writeObjectPartitions(*m, filename);
+  } else if (global.params.output_o && !assembleExternally &&
+             archiveInMemory()) {
+#if LDC_LLVM_VER >= 309
+    Logger::println("Generating object code for: %s\n", filename.c_str());
+    llvm::SmallString<0> objectCode;
+    {
+      llvm::raw_svector_ostream out(objectCode);
+      codegenModule(*gTargetMachine, *m, out,
+                    llvm::TargetMachine::CGFT_ObjectFile);
+    }
+    addInMemoryObject(filename.c_str(), objectCode);
+#endif
+  } else if (global.params.output_o && !assembleExternally) {
     Logger::println("Writing object file to: %s\n", filename.c_str());
     ErrorInfo errinfo;
     {
@@ -443,5 +744,7 @@ void writeModule(llvm::Module *m, std::string filename) {
     }
   }
 
-#undef ERRORINFO_STRING
+  jobs.wait();
 }
+
+#undef ERRORINFO_STRING
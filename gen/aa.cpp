@@ -85,7 +85,7 @@ DValue *DtoAAIndex(Loc &loc, Type *type, DValue *aa, DValue *key, bool lvalue) {
 
     LLValue *nullaa = LLConstant::getNullValue(ret->getType());
     LLValue *cond = gIR->ir->CreateICmpNE(nullaa, ret, "aaboundscheck");
-    gIR->ir->CreateCondBr(cond, okbb, failbb);
+    DtoCondBrToFailure(cond, okbb, failbb);
 
     // set up failbb to call the array bounds error runtime function
 
@@ -135,6 +135,18 @@ static void DtoArrayInit(Loc &loc, LLValue *ptr, LLValue *length,
     return;
   }
 
+  // The same goes for structs whose init symbol is all zero.
+  if (LLConstant *init = DtoStructInitializerOf(dvalue->type, value)) {
+    if (init->isNullValue()) {
+      LLValue *nbytes = gIR->ir->CreateMul(
+          length,
+          DtoConstSize_t(getTypeAllocSize(ptr->getType()->getContainedType(0))),
+          ".nbytes");
+      DtoMemSetZero(ptr, nbytes);
+      return;
+    }
+  }
+
   // create blocks
   llvm::BasicBlock *condbb = llvm::BasicBlock::Create(
       gIR->context(), "arrayinit.cond", gIR->topfunc());
@@ -1204,7 +1216,7 @@ void DtoIndexBoundsCheck(Loc &loc, DValue *arr, DValue *index) {
       llvm::BasicBlock::Create(gIR->context(), "bounds.fail", gIR->topfunc());
   llvm::BasicBlock *okbb =
       llvm::BasicBlock::Create(gIR->context(), "bounds.ok", gIR->topfunc());
-  gIR->ir->CreateCondBr(cond, okbb, failbb);
+  DtoCondBrToFailure(cond, okbb, failbb);
 
   // set up failbb to call the array bounds error runtime function
   gIR->scope() = IRScope(failbb);
@@ -20,7 +20,9 @@
 #include "gen/irstate.h"
 #include "gen/llvmhelpers.h"
 #include "gen/logger.h"
+#include "gen/metadata.h"
 #include "gen/nested.h"
+#include "gen/optimizer.h"
 #include "gen/rttibuilder.h"
 #include "gen/runtime.h"
 #include "gen/structs.h"
@@ -106,7 +108,14 @@ DValue *DtoNewClass(Loc &loc, TypeClass *tc, NewExp *newexp) {
   }
 
   // init
-  DtoInitClass(tc, mem);
+  if (newexp->onstack || newexp->allocator) {
+    DtoInitClass(tc, mem);
+  } else {
+    // _d_newclass already copies the init symbol into the new instance. The
+    // vtable pointer is stored once more to let the optimizer see the
+    // dynamic type.
+    DtoInitClass(tc, mem, /*vtblOnly=*/true);
+  }
 
   // init inner-class outer reference
   if (newexp->thisexp) {
@@ -146,7 +155,7 @@ DValue *DtoNewClass(Loc &loc, TypeClass *tc, NewExp *newexp) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void DtoInitClass(TypeClass *tc, LLValue *dst) {
+void DtoInitClass(TypeClass *tc, LLValue *dst, bool vtblOnly) {
   DtoResolveClass(tc->sym);
 
   // Set vtable field. Doing this seperately might be optimized better.
@@ -154,6 +163,9 @@ void DtoInitClass(TypeClass *tc, LLValue *dst) {
   LLValue *val = DtoBitCast(getIrAggr(tc->sym)->getVtblSymbol(),
                             tmp->getType()->getContainedType(0));
   DtoStore(val, tmp);
+  if (vtblOnly) {
+    return;
+  }
 
   // For D classes, set the monitor field to null.
   const bool isCPPclass = tc->sym->isCPPclass() ? true : false;
@@ -174,11 +186,19 @@ void DtoInitClass(TypeClass *tc, LLValue *dst) {
   LLValue *dstarr = DtoGEPi(dst, 0, firstDataIdx);
 
   // init symbols might not have valid types
-  LLValue *initsym = getIrAggr(tc->sym)->getInitSymbol();
-  initsym = DtoBitCast(initsym, DtoType(tc));
+  LLGlobalVariable *initGlobal = getIrAggr(tc->sym)->getInitSymbol();
+  LLValue *initsym = DtoBitCast(initGlobal, DtoType(tc));
   LLValue *srcarr = DtoGEPi(initsym, 0, firstDataIdx);
 
-  DtoMemCpy(dstarr, srcarr, DtoConstSize_t(dataBytes));
+  // If the class is defined in this module, store only the non-zero fields
+  // when most of the instance is zero-initialized.
+  if (initGlobal->hasDefinitiveInitializer()) {
+    DtoMemInitFromConstant(dstarr, srcarr, initGlobal->getInitializer(),
+                           Target::ptrsize * firstDataIdx, dataBytes,
+                           Target::ptrsize);
+  } else {
+    DtoMemCpy(dstarr, srcarr, DtoConstSize_t(dataBytes));
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -322,6 +342,140 @@ DValue *DtoCastClass(Loc &loc, DValue *val, Type *_to) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// Emits a dynamic cast of the object or interface pointer ptr, which must not
+/// be null, to the given target class/interface.
+///
+/// If ptr is an object and the target is a final class, the vtable pointer is
+/// compared directly.
+/// Otherwise, the offset between ptr and the cast result (or -1 if the cast
+/// failed) is cached for the last vtable pointer seen at this call site, and
+/// the runtime function is only called on a cache miss.
+static LLValue *DtoCachedDynamicCast(LLValue *ptr, llvm::Function *func,
+                                     LLValue *cinfo, ClassDeclaration *target,
+                                     bool fromObject) {
+  LLType *voidPtrTy = getVoidPtrType();
+  LLValue *vtbl = DtoLoad(DtoBitCast(ptr, getPtrToType(voidPtrTy)), ".vtbl");
+
+  // Final classes cannot be derived from, so the object has to be an
+  // instance of exactly that class. Template instances are excluded, as
+  // their vtables might be duplicated across shared libraries.
+  if (fromObject && (target->storage_class & STCfinal) &&
+      !target->isInterfaceDeclaration() && !DtoIsTemplateInstance(target)) {
+    LLValue *targetVtbl =
+        DtoBitCast(getIrAggr(target)->getVtblSymbol(), voidPtrTy);
+    LLValue *isInstance =
+        gIR->ir->CreateICmpEQ(vtbl, targetVtbl, ".isinstance");
+    return gIR->ir->CreateSelect(isInstance, DtoBitCast(ptr, voidPtrTy),
+                                 getNullPtr(voidPtrTy));
+  }
+
+  LLFunctionType *funcTy = func->getFunctionType();
+  ptr = DtoBitCast(ptr, funcTy->getParamType(0));
+  cinfo = DtoBitCast(cinfo, funcTy->getParamType(1));
+
+  // The cache would need to be updated atomically without TLS. Looking up
+  // emulated TLS, which the JIT uses, costs about as much as the runtime call.
+#if LDC_LLVM_VER >= 308
+  const bool emulatedTLS = gTargetMachine->Options.EmulatedTLS;
+#else
+  const bool emulatedTLS = false;
+#endif
+  if (global.params.disableTls || gCompileForJIT || emulatedTLS ||
+      isOptimizingForSize()) {
+    return gIR->CreateCallOrInvoke(func, ptr, cinfo).getInstruction();
+  }
+
+  LLType *sizeTy = DtoSize_t();
+  LLStructType *cacheTy = LLStructType::get(gIR->context(), voidPtrTy, sizeTy,
+                                            nullptr);
+  LLConstant *cacheInit = LLConstantStruct::get(
+      cacheTy, getNullPtr(voidPtrTy), LLConstantInt::getAllOnesValue(sizeTy),
+      nullptr);
+  // Thread-local, so that the two fields are always consistent. The cache is
+  // internal, so the local-dynamic model suffices for PIC code (one
+  // __tls_get_addr call per function at most), and LLVM relaxes it to
+  // local-exec in executables.
+  auto cache = new llvm::GlobalVariable(
+      gIR->module, cacheTy, false, llvm::GlobalValue::InternalLinkage,
+      cacheInit, ".dyncast.cache", nullptr,
+      llvm::GlobalVariable::LocalDynamicTLSModel);
+  LLValue *cacheVtbl = DtoGEPi(cache, 0, 0);
+  LLValue *cacheOffset = DtoGEPi(cache, 0, 1);
+
+  llvm::BasicBlock *hitbb = llvm::BasicBlock::Create(
+      gIR->context(), "dyncast.hit", gIR->topfunc());
+  llvm::BasicBlock *missbb = llvm::BasicBlock::Create(
+      gIR->context(), "dyncast.miss", gIR->topfunc());
+  llvm::BasicBlock *endbb = llvm::BasicBlock::Create(
+      gIR->context(), "dyncast.end", gIR->topfunc());
+
+  LLValue *isHit =
+      gIR->ir->CreateICmpEQ(vtbl, DtoLoad(cacheVtbl), ".dyncast.ishit");
+  llvm::BranchInst::Create(hitbb, missbb, isHit, gIR->scopebb());
+
+  // hit: apply the cached offset
+  gIR->scope() = IRScope(hitbb);
+  LLValue *offset = DtoLoad(cacheOffset);
+  LLValue *isFailure = gIR->ir->CreateICmpEQ(
+      offset, LLConstantInt::getAllOnesValue(sizeTy), ".dyncast.failed");
+  LLValue *hitResult = gIR->ir->CreateSelect(
+      isFailure, getNullPtr(voidPtrTy),
+      DtoGEP1(DtoBitCast(ptr, voidPtrTy), offset, true));
+  llvm::BranchInst::Create(endbb, gIR->scopebb());
+
+  // miss: call the runtime and update the cache
+  gIR->scope() = IRScope(missbb);
+  LLValue *missResult = DtoBitCast(
+      gIR->CreateCallOrInvoke(func, ptr, cinfo).getInstruction(), voidPtrTy);
+  LLValue *newOffset = gIR->ir->CreateSub(
+      gIR->ir->CreatePtrToInt(missResult, sizeTy),
+      gIR->ir->CreatePtrToInt(ptr, sizeTy));
+  newOffset = gIR->ir->CreateSelect(
+      gIR->ir->CreateIsNull(missResult),
+      LLConstantInt::getAllOnesValue(sizeTy), newOffset);
+  DtoStore(vtbl, cacheVtbl);
+  DtoStore(newOffset, cacheOffset);
+  llvm::BasicBlock *missendbb = gIR->scopebb();
+  llvm::BranchInst::Create(endbb, missendbb);
+
+  gIR->scope() = IRScope(endbb);
+  llvm::PHINode *phi = gIR->ir->CreatePHI(voidPtrTy, 2, ".dyncast");
+  phi->addIncoming(hitResult, hitbb);
+  phi->addIncoming(missResult, missendbb);
+  return phi;
+}
+
+/// Emits `ptr is null ? null : DtoCachedDynamicCast(...)` and wraps the
+/// result in a DValue of the target type.
+static DValue *DtoDynamicCast(LLValue *ptr, llvm::Function *func, Type *_to,
+                              bool fromObject) {
+  TypeClass *to = static_cast<TypeClass *>(_to->toBasetype());
+  DtoResolveClass(to->sym);
+  LLValue *cinfo = getIrAggr(to->sym)->getClassInfoSymbol();
+
+  llvm::BasicBlock *castbb = llvm::BasicBlock::Create(
+      gIR->context(), "dyncast.nonnull", gIR->topfunc());
+  llvm::BasicBlock *endbb = llvm::BasicBlock::Create(
+      gIR->context(), "dyncast.done", gIR->topfunc());
+
+  llvm::BasicBlock *entrybb = gIR->scopebb();
+  LLValue *isNull = gIR->ir->CreateIsNull(ptr, ".nullcheck");
+  llvm::BranchInst::Create(endbb, castbb, isNull, entrybb);
+
+  gIR->scope() = IRScope(castbb);
+  LLValue *ret = DtoCachedDynamicCast(ptr, func, cinfo, to->sym, fromObject);
+  llvm::BasicBlock *castendbb = gIR->scopebb();
+  llvm::BranchInst::Create(endbb, castendbb);
+
+  gIR->scope() = IRScope(endbb);
+  llvm::PHINode *phi = gIR->ir->CreatePHI(ret->getType(), 2, ".dyncast");
+  phi->addIncoming(getNullPtr(ret->getType()), entrybb);
+  phi->addIncoming(ret, castendbb);
+
+  // cast return value
+  return new DImValue(_to, DtoBitCast(phi, DtoType(_to)));
+}
+
 DValue *DtoDynamicCastObject(Loc &loc, DValue *val, Type *_to) {
   // call:
   // Object _d_dynamic_cast(Object o, ClassInfo c)
@@ -331,31 +485,11 @@ DValue *DtoDynamicCastObject(Loc &loc, DValue *val, Type *_to) {
 
   llvm::Function *func =
       getRuntimeFunction(loc, gIR->module, "_d_dynamic_cast");
-  LLFunctionType *funcTy = func->getFunctionType();
 
   // Object o
   LLValue *obj = val->getRVal();
-  obj = DtoBitCast(obj, funcTy->getParamType(0));
-  assert(funcTy->getParamType(0) == obj->getType());
 
-  // ClassInfo c
-  TypeClass *to = static_cast<TypeClass *>(_to->toBasetype());
-  DtoResolveClass(to->sym);
-
-  LLValue *cinfo = getIrAggr(to->sym)->getClassInfoSymbol();
-  // unfortunately this is needed as the implementation of object differs
-  // somehow from the declaration
-  // this could happen in user code as well :/
-  cinfo = DtoBitCast(cinfo, funcTy->getParamType(1));
-  assert(funcTy->getParamType(1) == cinfo->getType());
-
-  // call it
-  LLValue *ret = gIR->CreateCallOrInvoke(func, obj, cinfo).getInstruction();
-
-  // cast return value
-  ret = DtoBitCast(ret, DtoType(_to));
-
-  return new DImValue(_to, ret);
+  return DtoDynamicCast(obj, func, _to, true);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -369,28 +503,11 @@ DValue *DtoDynamicCastInterface(Loc &loc, DValue *val, Type *_to) {
 
   llvm::Function *func =
       getRuntimeFunction(loc, gIR->module, "_d_interface_cast");
-  LLFunctionType *funcTy = func->getFunctionType();
 
   // void* p
   LLValue *ptr = val->getRVal();
-  ptr = DtoBitCast(ptr, funcTy->getParamType(0));
 
-  // ClassInfo c
-  TypeClass *to = static_cast<TypeClass *>(_to->toBasetype());
-  DtoResolveClass(to->sym);
-  LLValue *cinfo = getIrAggr(to->sym)->getClassInfoSymbol();
-  // unfortunately this is needed as the implementation of object differs
-  // somehow from the declaration
-  // this could happen in user code as well :/
-  cinfo = DtoBitCast(cinfo, funcTy->getParamType(1));
-
-  // call it
-  LLValue *ret = gIR->CreateCallOrInvoke(func, ptr, cinfo).getInstruction();
-
-  // cast return value
-  ret = DtoBitCast(ret, DtoType(_to));
-
-  return new DImValue(_to, ret);
+  return DtoDynamicCast(ptr, func, _to, false);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -421,6 +538,27 @@ LLValue *DtoVirtualFunctionPointer(DValue *inst, FuncDeclaration *fdecl,
   // load funcptr
   funcval = DtoAlignedLoad(funcval);
 
+  // Tag the load with the static class type for class hierarchy
+  // devirtualization.
+  ClassDeclaration *cd =
+      static_cast<TypeClass *>(inst->getType()->toBasetype())->sym;
+  auto load = llvm::dyn_cast<llvm::LoadInst>(funcval);
+  if (opts::wholeProgramDevirt && load && !cd->isInterfaceDeclaration() &&
+      !cd->isCPPclass()) {
+    DtoResolveClass(cd);
+    LLType *i32 = LLType::getInt32Ty(gIR->context());
+#if LDC_LLVM_VER >= 306
+    llvm::Metadata *mdVals[] = {
+        llvm::ConstantAsMetadata::get(getIrAggr(cd)->getVtblSymbol()),
+        llvm::ConstantAsMetadata::get(
+            LLConstantInt::get(i32, fdecl->vtblIndex))};
+#else
+    MDNodeField *mdVals[] = {getIrAggr(cd)->getVtblSymbol(),
+                             LLConstantInt::get(i32, fdecl->vtblIndex)};
+#endif
+    load->setMetadata(VCALL_MD, llvm::MDNode::get(gIR->context(), mdVals));
+  }
+
   IF_LOG Logger::cout() << "funcval: " << *funcval << '\n';
 
   // cast to final funcptr type
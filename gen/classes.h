@@ -31,7 +31,10 @@ void DtoResolveClass(ClassDeclaration *cd);
 llvm::Constant *DtoDefineClassInfo(ClassDeclaration *cd);
 
 DValue *DtoNewClass(Loc &loc, TypeClass *type, NewExp *newexp);
-void DtoInitClass(TypeClass *tc, llvm::Value *dst);
+/// Initializes the class instance at dst with its init symbol. If vtblOnly is
+/// set, the memory already holds a copy of the init symbol and only the vtable
+/// pointer is stored again.
+void DtoInitClass(TypeClass *tc, llvm::Value *dst, bool vtblOnly = false);
 void DtoFinalizeClass(Loc &loc, llvm::Value *inst);
 
 DValue *DtoCastClass(Loc &loc, DValue *val, Type *to);
@@ -13,19 +13,11 @@
 #include "module.h"
 #include "gen/irstate.h"
 #include "gen/logger.h"
+#include "gen/tollvm.h"
+#include "ir/irfunction.h"
 
-void emitCoverageLinecountInc(Loc &loc) {
-  // Only emit coverage increment for locations in the source of the current
-  // module
-  // (for example, 'inlined' methods from other source files should be skipped).
-  if (!global.params.cov || !loc.linnum || !loc.filename ||
-      strcmp(gIR->dmodule->srcfile->name->toChars(), loc.filename) != 0) {
-    return;
-  }
-
-  const unsigned line = loc.linnum - 1; // convert to 0-based line# index
-  assert(line < gIR->dmodule->numlines);
-
+/// Increments the _d_cover_data element of the given line.
+static void emitLineCountInc(unsigned line) {
   IF_LOG Logger::println("Coverage: increment _d_cover_data[%d]", line);
   LOG_SCOPE;
 
@@ -46,6 +38,76 @@ void emitCoverageLinecountInc(Loc &loc) {
                            llvm::Monotonic
 #endif
                            );
+}
+
+/// -cov=fast: Increments the counter of the current basic block, unless
+/// another line in it has done so already, and records that the counter
+/// applies to the given line. The counters are added to _d_cover_data by the
+/// module destructor. A block ends at every call that may unwind as well (see
+/// endCoverageBlock()), so that the lines after it are counted separately.
+static void emitBlockCountInc(unsigned line) {
+  Module *m = gIR->dmodule;
+  auto &counters = gIR->func()->coverageBlockCounters;
+
+  auto it = counters.find(gIR->scopebb());
+  if (it != counters.end()) {
+    IF_LOG Logger::println("Coverage: line counted by _d_cover_blocks[%u]",
+                           it->second);
+    m->d_cover_block_lines[it->second].push_back(line);
+    return;
+  }
+
+  const unsigned counter = m->d_cover_block_lines.size();
+  counters[gIR->scopebb()] = counter;
+  m->d_cover_block_lines.push_back(std::vector<unsigned>(1, line));
+
+  IF_LOG Logger::println("Coverage: increment _d_cover_blocks[%u]", counter);
+
+  // _d_cover_blocks is an i32 placeholder until the number of counters is
+  // known at the end of the module.
+  LLValue *ptr = DtoGEPi1(m->d_cover_blocks, counter);
+
+  // A monotonic load and store instead of an atomic increment: concurrent
+  // increments may be lost, but never produce a torn or zero count.
+#if LDC_LLVM_VER >= 309
+  const auto ordering = llvm::AtomicOrdering::Monotonic;
+#else
+  const auto ordering = llvm::Monotonic;
+#endif
+  const unsigned alignment =
+      gDataLayout->getABITypeAlignment(LLType::getInt32Ty(gIR->context()));
+  llvm::LoadInst *load = gIR->ir->CreateLoad(ptr);
+  load->setAlignment(alignment);
+  load->setAtomic(ordering);
+  llvm::StoreInst *store =
+      gIR->ir->CreateStore(gIR->ir->CreateAdd(load, DtoConstUint(1)), ptr);
+  store->setAlignment(alignment);
+  store->setAtomic(ordering);
+}
+
+void endCoverageBlock() {
+  if (global.params.covFast) {
+    gIR->func()->coverageBlockCounters.erase(gIR->scopebb());
+  }
+}
+
+void emitCoverageLinecountInc(Loc &loc) {
+  // Only emit coverage increment for locations in the source of the current
+  // module
+  // (for example, 'inlined' methods from other source files should be skipped).
+  if (!global.params.cov || !loc.linnum || !loc.filename ||
+      strcmp(gIR->dmodule->srcfile->name->toChars(), loc.filename) != 0) {
+    return;
+  }
+
+  const unsigned line = loc.linnum - 1; // convert to 0-based line# index
+  assert(line < gIR->dmodule->numlines);
+
+  if (global.params.covFast) {
+    emitBlockCountInc(line);
+  } else {
+    emitLineCountInc(line);
+  }
 
   unsigned num_sizet_bits = gDataLayout->getTypeSizeInBits(DtoSize_t());
   unsigned idx = line / num_sizet_bits;
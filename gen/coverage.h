@@ -19,4 +19,8 @@ struct Loc;
 
 void emitCoverageLinecountInc(Loc &loc);
 
+/// -cov=fast: Makes the next covered line in the current basic block start a
+/// new counter. Called after a call that may unwind past the rest of the block.
+void endCoverageBlock();
+
 #endif
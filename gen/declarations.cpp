@@ -218,6 +218,8 @@ public:
     // emit typeinfo
     DtoTypeInfoOf(decl->type);
 
+    irs->DBuilder.EmitAggregateDefinition(decl);
+
     // Emit __xopEquals/__xopCmp/__xtoHash.
     if (decl->xeq && decl->xeq != decl->xerreq) {
       decl->xeq->accept(this);
@@ -270,6 +272,8 @@ public:
       classZ->setInitializer(ir->getClassInfoInit());
       setLinkage(lwc, classZ);
 
+      irs->DBuilder.EmitAggregateDefinition(decl);
+
       // No need to do TypeInfo here, it is <name>__classZ for classes in D2.
     }
   }
@@ -18,11 +18,13 @@
 #include "ir/irfunction.h"
 #include "ir/irtypeaggr.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "enum.h"
 #include "module.h"
 #include "mtype.h"
+#include "template.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -34,6 +36,33 @@ typedef llvm::DIDescriptor DIFlags;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static llvm::cl::opt<bool> importedTypesAsDecls(
+    "g-imported-types-decl",
+    llvm::cl::desc("Only emit debug info declarations for aggregates defined "
+                   "in other modules"),
+    llvm::cl::ZeroOrMore);
+
+static llvm::cl::opt<bool> skipImportedTemplates(
+    "g-skip-imported-templates",
+    llvm::cl::desc("Don't emit debug info for instances of templates declared "
+                   "in non-root modules"),
+    llvm::cl::ZeroOrMore);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// returns true if s is part of an instance of a template declared in a module
+// which is not compiled in this invocation
+static bool isImportedTemplateInstance(Dsymbol *s) {
+  TemplateInstance *ti = DtoIsTemplateInstance(s);
+  if (!ti || !ti->tempdecl) {
+    return false;
+  }
+  Module *m = ti->tempdecl->getModule();
+  return m && !m->isRoot();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // get the module the symbol is in, or - for template instances - the current
 // module
 Module *ldc::DIBuilder::getDefinedModule(Dsymbol *s) {
@@ -58,6 +87,11 @@ ldc::DIBuilder::DIBuilder(IRState *const IR)
 
 llvm::LLVMContext &ldc::DIBuilder::getContext() { return IR->context(); }
 
+bool ldc::DIBuilder::mustEmitLocationsDebugInfo() {
+  return global.params.symdebug &&
+         static_cast<llvm::MDNode *>(IR->func()->diSubprogram) != nullptr;
+}
+
 ldc::DIScope ldc::DIBuilder::GetCurrentScope() {
   IrFunction *fn = IR->func();
   if (fn->diLexicalBlocks.empty()) {
@@ -310,16 +344,31 @@ ldc::DIType ldc::DIBuilder::CreateCompositeType(Type *type) {
   IrTypeAggr *ir = sd->type->ctype->isAggr();
   assert(ir);
 
-  if (static_cast<llvm::MDNode *>(ir->diCompositeType) != nullptr) {
-    return ir->diCompositeType;
-  }
-
   // if we don't know the aggregate's size, we don't know enough about it
   // to provide debug info. probably a forward-declared struct?
   if (sd->sizeok == SIZEOKnone) {
     return DBuilder.createUnspecifiedType(sd->toChars());
   }
 
+  // The identifier allows the debugger and the linker (ODR type uniquing,
+  // type units) to match declarations and definitions across object files.
+  llvm::StringRef uniqueIdentifier = sd->type->deco ? sd->type->deco : "";
+  unsigned tag = (t->ty == Tstruct) ? llvm::dwarf::DW_TAG_structure_type
+                                    : llvm::dwarf::DW_TAG_class_type;
+
+  // Only the module defining the aggregate emits its members; the
+  // declarations are uniqued by LLVM, so they aren't cached.
+  if (importedTypesAsDecls && getDefinedModule(sd) != IR->dmodule) {
+    return DBuilder.createForwardDecl(tag, sd->toChars(), GetCU(),
+                                      CreateFile(sd->loc), sd->loc.linnum, 0,
+                                      getTypeAllocSize(T) * 8,
+                                      getABITypeAlign(T) * 8, uniqueIdentifier);
+  }
+
+  if (static_cast<llvm::MDNode *>(ir->diCompositeType) != nullptr) {
+    return ir->diCompositeType;
+  }
+
 // elements
 #if LDC_LLVM_VER >= 306
   std::vector<llvm::Metadata *> elems;
@@ -340,8 +389,6 @@ ldc::DIType ldc::DIBuilder::CreateCompositeType(Type *type) {
 #endif
 
   // set diCompositeType to handle recursive types properly
-  unsigned tag = (t->ty == Tstruct) ? llvm::dwarf::DW_TAG_structure_type
-                                    : llvm::dwarf::DW_TAG_class_type;
 #if LDC_LLVM_VER >= 307
   ir->diCompositeType = DBuilder.createReplaceableCompositeType(
 #else
@@ -383,9 +430,17 @@ ldc::DIType ldc::DIBuilder::CreateCompositeType(Type *type) {
                                    getTypeAllocSize(T) * 8, // size in bits
                                    getABITypeAlign(T) * 8,  // alignment in bits
                                    0,                       // offset in bits,
-                                   DIFlags::FlagFwdDecl,    // flags
+                                   0,                       // flags
                                    derivedFrom,             // DerivedFrom
-                                   elemsArray);
+                                   elemsArray,
+#if LDC_LLVM_VER >= 307
+                                   nullptr, // VTableHolder
+#else
+                                   ldc::DIType(), // VTableHolder
+#endif
+                                   nullptr,         // TemplateParms
+                                   uniqueIdentifier // UniqueIdentifier
+                                   );
   } else {
     ret = DBuilder.createStructType(CU,     // compile unit where defined
                                     name,   // name
@@ -393,9 +448,17 @@ ldc::DIType ldc::DIBuilder::CreateCompositeType(Type *type) {
                                     linnum, // line number where defined
                                     getTypeAllocSize(T) * 8, // size in bits
                                     getABITypeAlign(T) * 8, // alignment in bits
-                                    DIFlags::FlagFwdDecl,   // flags
+                                    0,                      // flags
                                     derivedFrom,            // DerivedFrom
-                                    elemsArray);
+                                    elemsArray,
+                                    0, // RunTimeLang
+#if LDC_LLVM_VER >= 307
+                                    nullptr, // VTableHolder
+#else
+                                    ldc::DIType(), // VTableHolder
+#endif
+                                    uniqueIdentifier // UniqueIdentifier
+                                    );
   }
 
 #if LDC_LLVM_VER >= 307
@@ -614,7 +677,8 @@ void ldc::DIBuilder::EmitCompileUnit(Module *m) {
 }
 
 ldc::DISubprogram ldc::DIBuilder::EmitSubProgram(FuncDeclaration *fd) {
-  if (!global.params.symdebug) {
+  if (!global.params.symdebug ||
+      (skipImportedTemplates && isImportedTemplateInstance(fd))) {
 #if LDC_LLVM_VER >= 307
     return nullptr;
 #else
@@ -717,31 +781,31 @@ ldc::DISubprogram ldc::DIBuilder::EmitModuleCTor(llvm::Function *Fn,
 }
 
 void ldc::DIBuilder::EmitFuncStart(FuncDeclaration *fd) {
-  if (!global.params.symdebug) {
+  if (!global.params.symdebug ||
+      static_cast<llvm::MDNode *>(getIrFunc(fd)->diSubprogram) == nullptr) {
     return;
   }
 
   Logger::println("D to dwarf funcstart");
   LOG_SCOPE;
 
-  assert(static_cast<llvm::MDNode *>(getIrFunc(fd)->diSubprogram) != 0);
   EmitStopPoint(fd->loc);
 }
 
 void ldc::DIBuilder::EmitFuncEnd(FuncDeclaration *fd) {
-  if (!global.params.symdebug) {
+  if (!global.params.symdebug ||
+      static_cast<llvm::MDNode *>(getIrFunc(fd)->diSubprogram) == nullptr) {
     return;
   }
 
   Logger::println("D to dwarf funcend");
   LOG_SCOPE;
 
-  assert(static_cast<llvm::MDNode *>(getIrFunc(fd)->diSubprogram) != 0);
   EmitStopPoint(fd->endloc);
 }
 
 void ldc::DIBuilder::EmitBlockStart(Loc &loc) {
-  if (!global.params.symdebug) {
+  if (!mustEmitLocationsDebugInfo()) {
     return;
   }
 
@@ -763,7 +827,7 @@ void ldc::DIBuilder::EmitBlockStart(Loc &loc) {
 }
 
 void ldc::DIBuilder::EmitBlockEnd() {
-  if (!global.params.symdebug) {
+  if (!mustEmitLocationsDebugInfo()) {
     return;
   }
 
@@ -776,7 +840,7 @@ void ldc::DIBuilder::EmitBlockEnd() {
 }
 
 void ldc::DIBuilder::EmitStopPoint(Loc &loc) {
-  if (!global.params.symdebug) {
+  if (!mustEmitLocationsDebugInfo()) {
     return;
   }
 
@@ -802,13 +866,17 @@ void ldc::DIBuilder::EmitStopPoint(Loc &loc) {
 }
 
 void ldc::DIBuilder::EmitValue(llvm::Value *val, VarDeclaration *vd) {
+  if (!mustEmitLocationsDebugInfo()) {
+    return;
+  }
+
   auto sub = IR->func()->variableMap.find(vd);
   if (sub == IR->func()->variableMap.end()) {
     return;
   }
 
   ldc::DILocalVariable debugVariable = sub->second;
-  if (!global.params.symdebug || !debugVariable) {
+  if (!debugVariable) {
     return;
   }
 
@@ -832,7 +900,7 @@ void ldc::DIBuilder::EmitLocalVariable(llvm::Value *ll, VarDeclaration *vd,
                                        llvm::ArrayRef<llvm::Value *> addr
 #endif
                                        ) {
-  if (!global.params.symdebug) {
+  if (!mustEmitLocationsDebugInfo()) {
     return;
   }
 
@@ -957,7 +1025,8 @@ void ldc::DIBuilder::EmitLocalVariable(llvm::Value *ll, VarDeclaration *vd,
 ldc::DIGlobalVariable
 ldc::DIBuilder::EmitGlobalVariable(llvm::GlobalVariable *ll,
                                    VarDeclaration *vd) {
-  if (!global.params.symdebug) {
+  if (!global.params.symdebug ||
+      (skipImportedTemplates && isImportedTemplateInstance(vd))) {
 #if LDC_LLVM_VER >= 307
     return nullptr;
 #else
@@ -985,6 +1054,19 @@ ldc::DIBuilder::EmitGlobalVariable(llvm::GlobalVariable *ll,
       );
 }
 
+void ldc::DIBuilder::EmitAggregateDefinition(AggregateDeclaration *ad) {
+  // Modules importing the aggregate rely on its definition being emitted
+  // here, even if it isn't referenced by anything in this module.
+  if (!global.params.symdebug || !importedTypesAsDecls) {
+    return;
+  }
+
+  Logger::println("D to dwarf aggregate definition");
+  LOG_SCOPE;
+
+  DBuilder.retainType(CreateCompositeType(ad->type));
+}
+
 void ldc::DIBuilder::Finalize() {
   if (!global.params.symdebug) {
     return;
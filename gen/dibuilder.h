@@ -21,6 +21,7 @@
 
 struct IRState;
 
+class AggregateDeclaration;
 class ClassDeclaration;
 class Dsymbol;
 class FuncDeclaration;
@@ -149,10 +150,16 @@ public:
   DIGlobalVariable EmitGlobalVariable(llvm::GlobalVariable *ll,
                                       VarDeclaration *vd); // FIXME
 
+  /// \brief Emits the full debug info type of an aggregate defined in the
+  /// current module if other modules only emit declarations for it.
+  /// \param ad       Aggregate declaration being defined.
+  void EmitAggregateDefinition(AggregateDeclaration *ad);
+
   void Finalize();
 
 private:
   llvm::LLVMContext &getContext();
+  bool mustEmitLocationsDebugInfo();
   Module *getDefinedModule(Dsymbol *s);
   DIScope GetCurrentScope();
   void Declare(const Loc &loc, llvm::Value *var, ldc::DILocalVariable divar
@@ -588,6 +588,22 @@ void DtoDeclareFunction(FuncDeclaration *fdecl) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// Returns the root module which defines the template instance the function
+/// belongs to, if it is another one than the current module.
+///
+/// The frontend appends each instance to the members of one module (see
+/// TemplateInstance::appendToModuleMember()), which then emits it. This isn't
+/// necessarily the module instantiating it first (minst), e.g. for
+/// speculative instances or with -unittest.
+static Module *getOtherDefiningModule(FuncDeclaration *fdecl) {
+  TemplateInstance *ti = fdecl->isInstantiated();
+  if (!ti || !ti->needsCodegen()) {
+    return nullptr;
+  }
+  Module *owner = ti->emittingModule;
+  return owner && owner != gIR->dmodule ? owner : nullptr;
+}
+
 static LinkageWithCOMDAT lowerFuncLinkage(FuncDeclaration *fdecl) {
   // Intrinsics are always external.
   if (DtoIsIntrinsic(fdecl)) {
@@ -675,6 +691,17 @@ void DtoDefineFunction(FuncDeclaration *fd) {
     }
   }
 
+  if (defineTemplatesInOwnerOnly) {
+    if (Module *owner = getOtherDefiningModule(fd)) {
+      IF_LOG Logger::println("Skipping '%s', defined by owner module '%s'.",
+                             fd->toPrettyChars(), owner->toChars());
+      // Callers may still take the address of the declaration.
+      DtoDeclareFunction(fd);
+      fd->ir.setDefined();
+      return;
+    }
+  }
+
   DtoDeclareFunction(fd);
   assert(fd->ir.isDeclared());
 
@@ -771,6 +798,14 @@ void DtoDefineFunction(FuncDeclaration *fd) {
       func->addFnAttr(LLAttribute::SanitizeThread);
     }
   }
+#if LDC_LLVM_VER >= 400
+  // Functions can opt in or out regardless of their size with
+  // @llvmAttr("function-instrument", "xray-always") or "xray-never".
+  if (opts::instrumentXRay && !func->hasFnAttribute("function-instrument")) {
+    func->addFnAttr("xray-instruction-threshold",
+                    std::to_string(opts::xrayInstructionThreshold));
+  }
+#endif
 
   llvm::BasicBlock *beginbb =
       llvm::BasicBlock::Create(gIR->context(), "", func);
@@ -942,6 +977,8 @@ void DtoDefineFunction(FuncDeclaration *fd) {
   gIR->scopes.pop_back();
 
   gIR->functions.pop_back();
+
+  applyFuncDefUDAs(fd, func);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -42,6 +42,10 @@ extern llvm::TargetMachine *gTargetMachine;
 extern const llvm::DataLayout *gDataLayout;
 extern TargetABI *gABI;
 
+// whether the code is run in-process by the JIT (-run=jit) instead of being
+// written to object files
+extern bool gCompileForJIT;
+
 class TypeFunction;
 class TypeStruct;
 class ClassDeclaration;
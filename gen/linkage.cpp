@@ -10,3 +10,4 @@
 #include "linkage.h"
 
 LLGlobalValue::LinkageTypes templateLinkage;
+bool defineTemplatesInOwnerOnly = false;
@@ -24,4 +24,9 @@
 
 extern LLGlobalValue::LinkageTypes templateLinkage;
 
+// If set, functions in template instances are only defined in the object file
+// of the root module the frontend has assigned the instance to, and are
+// referenced as external symbols from the other root modules.
+extern bool defineTemplatesInOwnerOnly;
+
 #endif
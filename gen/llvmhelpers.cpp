@@ -33,6 +33,7 @@
 #include "mars.h"
 #include "module.h"
 #include "template.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
@@ -256,6 +257,14 @@ void DtoAssert(Module *M, Loc &loc, DValue *msg) {
   gIR->ir->CreateUnreachable();
 }
 
+void DtoCondBrToFailure(LLValue *okCond, llvm::BasicBlock *okbb,
+                        llvm::BasicBlock *failbb) {
+  // The same weights as Clang uses for __builtin_expect.
+  llvm::MDBuilder mdb(gIR->context());
+  gIR->ir->CreateCondBr(okCond, okbb, failbb,
+                        mdb.createBranchWeights(2000, 1));
+}
+
 /******************************************************************************
  * MODULE FILE NAME
  ******************************************************************************/
@@ -285,6 +294,19 @@ void DtoGoto(Loc &loc, LabelDsymbol *target) {
  * ASSIGNMENT HELPER (store this in that)
  ******************************************************************************/
 
+llvm::Constant *DtoStructInitializerOf(Type *t, llvm::Value *val) {
+  t = t->toBasetype();
+  if (t->ty != Tstruct ||
+      !llvm::isa<llvm::GlobalVariable>(val->stripPointerCasts())) {
+    return nullptr;
+  }
+  IrAggr *irAggr = getIrAggr(static_cast<TypeStruct *>(t)->sym);
+  if (val->stripPointerCasts() != irAggr->getInitSymbol()) {
+    return nullptr;
+  }
+  return irAggr->getDefaultInit();
+}
+
 // is this a good approach at all ?
 
 void DtoAssign(Loc &loc, DValue *lhs, DValue *rhs, int op,
@@ -309,7 +331,15 @@ void DtoAssign(Loc &loc, DValue *lhs, DValue *rhs, int op,
       // time as to not emit an invalid (overlapping) memcpy on trivial
       // struct self-assignments like 'A a; a = a;'.
       if (src != dst) {
-        DtoMemCpy(dst, src);
+        // Default initialization from a mostly zero init symbol is cheaper
+        // as a memset and a few stores.
+        if (LLConstant *init = DtoStructInitializerOf(t, src)) {
+          DtoMemInitFromConstant(
+              dst, src, init, 0,
+              getTypeStoreSize(dst->getType()->getContainedType(0)));
+        } else {
+          DtoMemCpy(dst, src);
+        }
       }
     }
   } else if (t->ty == Tarray || t->ty == Tsarray) {
@@ -57,6 +57,12 @@ LLValue *DtoAllocaDump(LLValue *val, LLType *asType, int alignment = 0,
 // assertion generator
 void DtoAssert(Module *M, Loc &loc, DValue *msg);
 
+/// Branches to okbb if okCond is true, and to failbb otherwise, which calls a
+/// runtime failure hook. The failure branch is marked as very unlikely, so
+/// that the failure block is moved out of the hot code.
+void DtoCondBrToFailure(LLValue *okCond, llvm::BasicBlock *okbb,
+                        llvm::BasicBlock *failbb);
+
 // returns module file name
 LLValue *DtoModuleFileName(Module *M, const Loc &loc);
 
@@ -77,6 +83,10 @@ void DtoLeaveMonitor(Loc &loc, LLValue *v);
 void DtoAssign(Loc &loc, DValue *lhs, DValue *rhs, int op = -1,
                bool canSkipPostblit = false);
 
+/// Returns the default initializer of the struct type t if val is its init
+/// symbol, and null otherwise.
+llvm::Constant *DtoStructInitializerOf(Type *t, llvm::Value *val);
+
 DValue *DtoSymbolAddress(Loc &loc, Type *type, Declaration *decl);
 llvm::Constant *DtoConstSymbolAddress(Loc &loc, Declaration *decl);
 
@@ -43,9 +43,36 @@ enum ClassDataFields {
   CD_BodyType,     /// A value of the LLVM type corresponding to the class body.
   CD_Finalize,     /// True if this class (or a base class) has a destructor.
   CD_CustomDelete, /// True if this class has an overridden delete operator.
+  CD_InitSymbol,   /// The init symbol of the class.
 
   // Must be kept last
   CD_NumFields /// The number of fields in ClassInfo metadata
 };
 
+// *** Metadata for class hierarchy analysis ***
+#define CH_NAME "llvm.ldc.classhierarchy"
+
+/// The fields in the metadata nodes of the CH_NAME named metadata, one for
+/// each class whose vtable is defined in the module.
+enum ClassHierarchyFields {
+  CH_Vtbl,     /// The vtable global of the class.
+  CH_BaseVtbl, /// The vtable global of the base class (null for Object).
+
+  // Must be kept last
+  CH_NumFields /// The number of fields in class hierarchy metadata
+};
+
+/// Attached to the vtable slot load of virtual calls. The operands are the
+/// vtable global of the static class type and the slot index.
+#define VCALL_MD "ldc.vcall"
+
+// *** Metadata for call sites ***
+
+/// Attached to calls which pass aggregates (delegates) to D parameters that
+/// are known not to escape (scope/lazy). The first operand is the number of
+/// LLVM call arguments, the remaining ones are the indices of the affected
+/// arguments. Passes rewriting the call (e.g. dead argument elimination) may
+/// keep the metadata, so it must be ignored if the count doesn't match.
+#define SCOPE_ARGS_MD "ldc.scope_args"
+
 #endif
@@ -29,6 +29,7 @@
 #include "gen/llvm.h"
 #include "gen/llvmhelpers.h"
 #include "gen/logger.h"
+#include "gen/modules.h"
 #include "gen/optimizer.h"
 #include "gen/programs.h"
 #include "gen/rttibuilder.h"
@@ -40,12 +41,15 @@
 #include "ir/irmodule.h"
 #include "ir/irtype.h"
 #include "ir/irvar.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/LinkAllPasses.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/DataLayout.h"
+#include <algorithm>
 
 #if _AIX || __sun
 #include <alloca.h>
@@ -644,6 +648,16 @@ static void addCoverageAnalysis(Module *m) {
                           m->d_cover_data, idxs, true));
   }
 
+  // -cov=fast: uint[# basic block counters] _d_cover_blocks, created with the
+  // final size by addCoverageAnalysisInitializer()
+  if (global.params.covFast) {
+    IF_LOG Logger::println("Build placeholder for _d_cover_blocks");
+    m->d_cover_blocks = new llvm::GlobalVariable(
+        gIR->module, LLType::getInt32Ty(gIR->context()), false,
+        LLGlobalValue::InternalLinkage, DtoConstUint(0), "_d_cover_blocks");
+    m->d_cover_block_lines.clear();
+  }
+
   // Create "static constructor" that calls _d_cover_register2(string filename,
   // size_t[] valid, uint[] data, ubyte minPercent)
   // Build ctor name
@@ -697,9 +711,125 @@ static void addCoverageAnalysis(Module *m) {
     getIrModule(m)->sharedCtors.push_back(fd);
   }
 
+  // -cov=fast: Add a "static destructor" that adds the block counters to
+  // _d_cover_data. Its body is generated along with the final _d_cover_blocks.
+  if (m->d_cover_blocks) {
+    std::string dtorname = "_D";
+    dtorname += mangle(m);
+    dtorname += "12_coverageanalysisDtor1FZv";
+    IF_LOG Logger::println("Add %s to module's shared static destructor list",
+                           dtorname.c_str());
+
+    LLFunctionType *dtorTy = LLFunctionType::get(
+        LLType::getVoidTy(gIR->context()), std::vector<LLType *>(), false);
+    LLFunction *dtor = LLFunction::Create(
+        dtorTy, LLGlobalValue::InternalLinkage, dtorname, &gIR->module);
+    dtor->setCallingConv(gABI->callingConv(dtor->getFunctionType(), LINKd));
+    if (global.params.targetTriple.getArch() == llvm::Triple::x86_64) {
+      dtor->addFnAttr(LLAttribute::UWTable);
+    }
+
+    FuncDeclaration *fd =
+        FuncDeclaration::genCfunc(nullptr, Type::tvoid, dtorname.c_str());
+    fd->linkage = LINKd;
+    IrFunction *irfunc = getIrFunc(fd, true);
+    irfunc->func = dtor;
+    getIrModule(m)->sharedDtors.push_back(fd);
+  }
+
   IF_LOG Logger::undent();
 }
 
+// -cov=fast: Replace the _d_cover_blocks placeholder by the array of block
+// counters and generate the module destructor adding them to the line counts
+// in _d_cover_data, i.e. for every (counter, line) pair in a table:
+//   _d_cover_data[line] += _d_cover_blocks[counter];
+static void addCoverageBlockCounters(Module *m) {
+  const size_t numBlocks = m->d_cover_block_lines.size();
+  IF_LOG Logger::println("Adding %llu coverage block counters",
+                         static_cast<unsigned long long>(numBlocks));
+  LOG_SCOPE;
+
+  LLType *i32Ty = LLType::getInt32Ty(gIR->context());
+
+  LLArrayType *blocksTy =
+      LLArrayType::get(i32Ty, std::max<size_t>(numBlocks, 1));
+  auto blocks = new llvm::GlobalVariable(
+      gIR->module, blocksTy, false, LLGlobalValue::InternalLinkage,
+      llvm::ConstantAggregateZero::get(blocksTy), "");
+  blocks->takeName(m->d_cover_blocks);
+  m->d_cover_blocks->replaceAllUsesWith(
+      DtoBitCast(blocks, m->d_cover_blocks->getType()));
+  m->d_cover_blocks->eraseFromParent();
+  m->d_cover_blocks = blocks;
+
+  // The (counter, line) pairs.
+  LLType *pairFieldTys[] = {i32Ty, i32Ty};
+  LLStructType *pairTy = LLStructType::get(gIR->context(), pairFieldTys);
+  std::vector<LLConstant *> pairs;
+  for (size_t i = 0; i < numBlocks; ++i) {
+    for (auto line : m->d_cover_block_lines[i]) {
+      LLConstant *fields[] = {DtoConstUint(static_cast<unsigned>(i)),
+                              DtoConstUint(line)};
+      pairs.push_back(LLConstantStruct::get(pairTy, fields));
+    }
+  }
+  m->d_cover_block_lines.clear();
+
+  std::string dtorname = "_D";
+  dtorname += mangle(m);
+  dtorname += "12_coverageanalysisDtor1FZv";
+  LLFunction *dtor = gIR->module.getFunction(dtorname);
+  assert(dtor && "coverage destructor not declared");
+
+  llvm::BasicBlock *entrybb =
+      llvm::BasicBlock::Create(gIR->context(), "", dtor);
+  IRBuilder<> builder(entrybb);
+  if (pairs.empty()) {
+    builder.CreateRetVoid();
+    return;
+  }
+
+  LLArrayType *tableTy = LLArrayType::get(pairTy, pairs.size());
+  auto table = new llvm::GlobalVariable(
+      gIR->module, tableTy, true, LLGlobalValue::PrivateLinkage,
+      LLConstantArray::get(tableTy, pairs), "_d_cover_block_lines");
+
+  llvm::BasicBlock *loopbb =
+      llvm::BasicBlock::Create(gIR->context(), "loop", dtor);
+  llvm::BasicBlock *endbb =
+      llvm::BasicBlock::Create(gIR->context(), "end", dtor);
+  builder.CreateBr(loopbb);
+
+  builder.SetInsertPoint(loopbb);
+  llvm::PHINode *i = builder.CreatePHI(DtoSize_t(), 2, "i");
+  i->addIncoming(DtoConstSize_t(0), entrybb);
+
+  LLValue *pairIdxs[] = {DtoConstSize_t(0), i, DtoConstUint(0)};
+  LLValue *counter = builder.CreateLoad(
+      builder.CreateInBoundsGEP(table, pairIdxs), "counter");
+  pairIdxs[2] = DtoConstUint(1);
+  LLValue *line =
+      builder.CreateLoad(builder.CreateInBoundsGEP(table, pairIdxs), "line");
+
+  LLValue *blockIdxs[] = {DtoConstSize_t(0), counter};
+  LLValue *count =
+      builder.CreateLoad(builder.CreateInBoundsGEP(blocks, blockIdxs));
+  LLValue *lineIdxs[] = {DtoConstSize_t(0), line};
+  LLValue *lineCount = builder.CreateInBoundsGEP(m->d_cover_data, lineIdxs);
+  builder.CreateStore(builder.CreateAdd(builder.CreateLoad(lineCount), count),
+                      lineCount);
+
+  LLValue *next = builder.CreateAdd(i, DtoConstSize_t(1), "i.next");
+  i->addIncoming(next, loopbb);
+  builder.CreateCondBr(
+      builder.CreateICmpULT(next, DtoConstSize_t(pairs.size())), loopbb,
+      endbb);
+
+  builder.SetInsertPoint(endbb);
+  builder.CreateRetVoid();
+}
+
 // Initialize _d_cover_valid for coverage analysis
 static void addCoverageAnalysisInitializer(Module *m) {
   IF_LOG Logger::println("Adding coverage analysis _d_cover_valid initializer");
@@ -777,6 +907,9 @@ void codegenModule(IRState *irs, Module *m, bool emitFullModuleInfo) {
   if (m->d_cover_valid) {
     addCoverageAnalysisInitializer(m);
   }
+  if (m->d_cover_blocks) {
+    addCoverageBlockCounters(m);
+  }
 
   gIR = nullptr;
   irs->dmodule = nullptr;
@@ -819,6 +952,20 @@ static void genModuleInfo(Module *m, bool emitFullModuleInfo) {
     importInits.push_back(
         DtoBitCast(getIrModule(mod)->moduleInfoSymbol(), moduleInfoPtrTy));
   }
+  // -cov=fast: The block counters are added to the line counts in a module
+  // destructor, which has to run before the one of druntime's rt.cover
+  // writing the coverage reports. Importing rt.cover ensures this.
+  if (m->d_cover_blocks) {
+    LLGlobalVariable *coverMI =
+        gIR->module.getGlobalVariable("_D2rt5cover12__ModuleInfoZ");
+    if (!coverMI) {
+      coverMI = new llvm::GlobalVariable(
+          gIR->module, llvm::StructType::create(gIR->context()), false,
+          LLGlobalValue::ExternalLinkage, nullptr,
+          "_D2rt5cover12__ModuleInfoZ");
+    }
+    importInits.push_back(DtoBitCast(coverMI, moduleInfoPtrTy));
+  }
   // has import array?
   if (!importInits.empty()) {
     importedModulesTy =
@@ -958,19 +1105,25 @@ static void genModuleInfo(Module *m, bool emitFullModuleInfo) {
   b.finalize(moduleInfoSym->getType()->getPointerElementType(), moduleInfoSym);
   setLinkage({LLGlobalValue::ExternalLinkage, false}, moduleInfoSym);
 
-  if ((global.params.targetTriple.isOSLinux() &&
-       global.params.targetTriple.getEnvironment() != llvm::Triple::Android) ||
-      global.params.targetTriple.isOSFreeBSD() ||
+  const llvm::Triple &triple = global.params.targetTriple;
+  bool useDSORegistry =
+      (triple.isOSLinux() && triple.getEnvironment() != llvm::Triple::Android) ||
 #if LDC_LLVM_VER > 305
-      global.params.targetTriple.isOSNetBSD() ||
-      global.params.targetTriple.isOSOpenBSD() ||
-      global.params.targetTriple.isOSDragonFly()
+      triple.isOSFreeBSD() || triple.isOSNetBSD() || triple.isOSOpenBSD() ||
+      triple.isOSDragonFly();
 #else
-      global.params.targetTriple.getOS() == llvm::Triple::NetBSD ||
-      global.params.targetTriple.getOS() == llvm::Triple::OpenBSD ||
-      global.params.targetTriple.getOS() == llvm::Triple::DragonFly
+      triple.isOSFreeBSD() || triple.getOS() == llvm::Triple::NetBSD ||
+      triple.getOS() == llvm::Triple::OpenBSD ||
+      triple.getOS() == llvm::Triple::DragonFly;
 #endif
-          ) {
+  // Code run by the JIT is not part of any loaded DSO, and druntime only
+  // consumes the _Dmodule_ref list on other platforms. runInProcess() runs the
+  // constructors of the ModuleInfos itself.
+  if (gCompileForJIT) {
+    return;
+  }
+
+  if (useDSORegistry) {
     if (emitFullModuleInfo) {
       build_dso_registry_calls(mangle(m), moduleInfoSym);
     } else {
@@ -983,3 +1136,100 @@ static void genModuleInfo(Module *m, bool emitFullModuleInfo) {
     AppendFunctionToLLVMGlobalCtorsDtors(mictor, 65535, true);
   }
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+/// Computes the order in which the constructors of one kind (shared or
+/// thread-local) have to run, like ModuleGroup.sortCtors() in druntime does at
+/// startup: the strongly connected components of the import graph are visited
+/// imports first (Tarjan's algorithm), and each component may contain at most
+/// one module with constructors or destructors of that kind.
+class CtorOrder {
+  llvm::function_ref<bool(Module *)> hasCtors;
+  bool shared;
+  unsigned nextIndex = 0;
+  llvm::DenseMap<Module *, std::pair<unsigned, unsigned>> indexAndLowLink;
+  std::vector<Module *> stack;
+  llvm::SmallPtrSet<Module *, 32> onStack;
+
+  void visit(Module *m) {
+    const unsigned index = nextIndex++;
+    indexAndLowLink[m] = {index, index};
+    stack.push_back(m);
+    onStack.insert(m);
+
+    for (size_t i = 0; i < m->aimports.dim; i++) {
+      Module *imp = m->aimports[i];
+      auto it = indexAndLowLink.find(imp);
+      if (it == indexAndLowLink.end()) {
+        visit(imp);
+        auto &lowLink = indexAndLowLink[m].second;
+        lowLink = std::min(lowLink, indexAndLowLink[imp].second);
+      } else if (onStack.count(imp)) {
+        auto &lowLink = indexAndLowLink[m].second;
+        lowLink = std::min(lowLink, it->second.first);
+      }
+    }
+
+    if (indexAndLowLink[m].second != index) {
+      return;
+    }
+
+    // m is the root of a strongly connected component.
+    std::vector<Module *> withCtors;
+    Module *member;
+    do {
+      member = stack.back();
+      stack.pop_back();
+      onStack.erase(member);
+      if (hasCtors(member)) {
+        withCtors.push_back(member);
+      }
+    } while (member != m);
+
+    if (withCtors.size() > 1) {
+      std::string names;
+      for (auto c : withCtors) {
+        if (!names.empty()) {
+          names += ", ";
+        }
+        names += c->toPrettyChars();
+      }
+      error(Loc(), "cyclic dependency between the %s constructors/destructors "
+                   "of modules %s",
+            shared ? "shared" : "thread-local", names.c_str());
+    }
+    order.insert(order.end(), withCtors.begin(), withCtors.end());
+  }
+
+public:
+  std::vector<Module *> order;
+
+  CtorOrder(llvm::function_ref<bool(Module *)> hasCtors, bool shared,
+            const std::vector<Module *> &modules)
+      : hasCtors(hasCtors), shared(shared) {
+    for (auto m : modules) {
+      if (!indexAndLowLink.count(m)) {
+        visit(m);
+      }
+    }
+  }
+};
+
+std::vector<Module *>
+getModuleCtorOrder(const std::vector<Module *> &modules, bool shared,
+                   llvm::function_ref<bool(Module *)> hasCtors) {
+  CtorOrder order(hasCtors, shared, modules);
+
+  IF_LOG {
+    Logger::println("%s module constructor order:",
+                    shared ? "Shared" : "Thread-local");
+    LOG_SCOPE;
+    for (auto m : order.order) {
+      Logger::println("%s", m->toPrettyChars());
+    }
+  }
+
+  return order.order;
+}
@@ -0,0 +1,28 @@
+//===-- gen/modules.h - Module-level code generation ------------*- C++ -*-===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LDC_GEN_MODULES_H
+#define LDC_GEN_MODULES_H
+
+#include "llvm/ADT/STLExtras.h"
+#include <vector>
+
+struct IRState;
+class Module;
+
+void codegenModule(IRState *irs, Module *m, bool emitFullModuleInfo);
+
+/// Returns the modules for which hasCtors() holds in the order in which their
+/// shared or thread-local constructors have to run, imports first. Reports an
+/// error if they depend on each other cyclically.
+std::vector<Module *>
+getModuleCtorOrder(const std::vector<Module *> &modules, bool shared,
+                   llvm::function_ref<bool(Module *)> hasCtors);
+
+#endif
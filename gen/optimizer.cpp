@@ -84,6 +84,18 @@ static cl::opt<bool> disableGCToStack(
     cl::desc("Disable promotion of GC allocations to stack memory"),
     cl::ZeroOrMore);
 
+cl::opt<bool> opts::wholeProgramDevirt(
+    "whole-program-devirt",
+    cl::desc("Devirtualize calls using class hierarchy analysis, assuming "
+             "that all subclasses are defined in the module (-singleobj)"),
+    cl::ZeroOrMore);
+
+cl::opt<bool> opts::stripDeadTypeInfo(
+    "strip-dead-typeinfo",
+    cl::desc("Remove unreferenced TypeInfo, vtables and empty ModuleInfos, "
+             "assuming that the module is the whole program (-singleobj)"),
+    cl::ZeroOrMore);
+
 static cl::opt<cl::boolOrDefault, false, opts::FlagParser<cl::boolOrDefault>>
     enableInlining(
         "inlining",
@@ -105,6 +117,20 @@ cl::opt<opts::SanitizerCheck> opts::sanitize(
                clEnumValN(opts::ThreadSanitizer, "thread", "race detection"),
                clEnumValEnd));
 
+#if LDC_LLVM_VER >= 400
+cl::opt<bool> opts::instrumentXRay(
+    "finstrument-functions-xray",
+    cl::desc("Emit XRay sleds at function entry and exit, which the XRay "
+             "runtime can patch to trace the program"),
+    cl::init(false));
+
+cl::opt<unsigned> opts::xrayInstructionThreshold(
+    "xray-instruction-threshold",
+    cl::desc("Only instrument functions with at least this number of machine "
+             "instructions (or a loop) with -finstrument-functions-xray"),
+    cl::value_desc("n"), cl::init(200));
+#endif
+
 static cl::opt<bool> disableLoopUnrolling(
     "disable-loop-unrolling",
     cl::desc("Disable loop unrolling in all relevant passes"), cl::init(false));
@@ -133,6 +159,8 @@ bool willInline() {
 
 bool isOptimizationEnabled() { return optimizeLevel != 0; }
 
+bool isOptimizingForSize() { return sizeLevel() != 0; }
+
 llvm::CodeGenOpt::Level codeGenOptLevel() {
   // Use same appoach as clang (see lib/CodeGen/BackendUtil.cpp)
   if (optLevel() == 0) {
@@ -174,6 +202,18 @@ static void addGarbageCollect2StackPass(const PassManagerBuilder &builder,
   }
 }
 
+static void addClassHierarchyDevirtPass(const PassManagerBuilder &builder,
+                                        PassManagerBase &pm) {
+  if (builder.OptLevel >= 1) {
+    addPass(pm, createClassHierarchyDevirtPass());
+  }
+}
+
+static void addStripDeadTypeInfoPass(const PassManagerBuilder &builder,
+                                     PassManagerBase &pm) {
+  addPass(pm, createStripDeadTypeInfoPass());
+}
+
 static void addAddressSanitizerPasses(const PassManagerBuilder &Builder,
                                       PassManagerBase &PM) {
   PM.add(createAddressSanitizerFunctionPass());
@@ -287,6 +327,20 @@ static void addOptimizationPasses(PassManagerBase &mpm,
       builder.addExtension(PassManagerBuilder::EP_LoopOptimizerEnd,
                            addGarbageCollect2StackPass);
     }
+
+    // Run before the inliner so that devirtualized calls can be inlined.
+    if (opts::wholeProgramDevirt) {
+      builder.addExtension(PassManagerBuilder::EP_ModuleOptimizerEarly,
+                           addClassHierarchyDevirtPass);
+    }
+  }
+
+  // Before stripping externals, so that GlobalDCE cleans up after it.
+  if (opts::stripDeadTypeInfo) {
+    builder.addExtension(PassManagerBuilder::EP_OptimizerLast,
+                         addStripDeadTypeInfoPass);
+    builder.addExtension(PassManagerBuilder::EP_EnabledOnOptLevel0,
+                         addStripDeadTypeInfoPass);
   }
 
   // EP_OptimizerLast does not exist in LLVM 3.0, add it manually below.
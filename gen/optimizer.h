@@ -30,6 +30,15 @@ enum SanitizerCheck {
 };
 
 extern llvm::cl::opt<SanitizerCheck> sanitize;
+
+extern llvm::cl::opt<bool> wholeProgramDevirt;
+
+extern llvm::cl::opt<bool> stripDeadTypeInfo;
+
+#if LDC_LLVM_VER >= 400
+extern llvm::cl::opt<bool> instrumentXRay;
+extern llvm::cl::opt<unsigned> xrayInstructionThreshold;
+#endif
 }
 
 namespace llvm {
@@ -43,6 +52,9 @@ bool willInline();
 
 bool isOptimizationEnabled();
 
+// Returns whether -Os or -Oz is in effect.
+bool isOptimizingForSize();
+
 llvm::CodeGenOpt::Level codeGenOptLevel();
 
 void verifyModule(llvm::Module *m);
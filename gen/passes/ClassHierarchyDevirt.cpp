@@ -0,0 +1,321 @@
+//===-- ClassHierarchyDevirt.cpp - Devirtualize calls using the CHA -------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass uses the class hierarchy recorded in the CH_NAME metadata to
+// replace loads of vtable slots (tagged with VCALL_MD) by the only function
+// the static class type and all its subclasses have in that slot.
+//
+// If there are several candidates, calls are speculatively devirtualized to
+// the implementation of the static type, guarded by a comparison with the
+// loaded function pointer, so that the common case can be inlined.
+//
+// This is only correct if all subclasses of a class are defined in the
+// module, i.e. if the module contains the whole program.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "dclass-devirt"
+
+#include "Passes.h"
+
+#include "llvm/Pass.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+STATISTIC(NumDevirtualized, "Number of virtual calls devirtualized");
+STATISTIC(NumSpeculative,
+          "Number of virtual calls speculatively devirtualized");
+
+static cl::opt<bool>
+    Speculative("dclass-devirt-speculative", cl::init(true), cl::Hidden,
+                cl::desc("Speculatively devirtualize calls which have "
+                         "several possible targets"));
+
+namespace {
+class LLVM_LIBRARY_VISIBILITY ClassHierarchyDevirt : public ModulePass {
+  /// Maps vtables to the vtables of their direct subclasses.
+  DenseMap<GlobalVariable *, SmallVector<GlobalVariable *, 4>> Subclasses;
+
+  bool collectTargets(GlobalVariable *Vtbl, uint64_t Slot,
+                      SmallPtrSet<Function *, 4> &Targets);
+  bool devirtualize(LoadInst *Load);
+
+public:
+  static char ID; // Pass identification
+  ClassHierarchyDevirt() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+};
+char ClassHierarchyDevirt::ID = 0;
+} // end anonymous namespace.
+
+static RegisterPass<ClassHierarchyDevirt>
+    X("dclass-devirt", "Devirtualize D virtual calls using the class hierarchy");
+
+// Public interface to the pass.
+ModulePass *createClassHierarchyDevirtPass() {
+  return new ClassHierarchyDevirt();
+}
+
+static Constant *getConstantOperand(MDNode *Node, unsigned I) {
+#if LDC_LLVM_VER >= 306
+  return mdconst::dyn_extract_or_null<Constant>(Node->getOperand(I));
+#else
+  return dyn_cast_or_null<Constant>(Node->getOperand(I));
+#endif
+}
+
+/// Adds the function in the given slot of Vtbl and of all the subclass vtables
+/// to Targets. Returns false if any of the vtables is not known.
+bool ClassHierarchyDevirt::collectTargets(GlobalVariable *Vtbl, uint64_t Slot,
+                                          SmallPtrSet<Function *, 4> &Targets) {
+  if (!Vtbl->hasDefinitiveInitializer()) {
+    return false;
+  }
+
+  Constant *Entry = Vtbl->getInitializer()->getAggregateElement(Slot);
+  if (!Entry) {
+    return false;
+  }
+  Entry = Entry->stripPointerCasts();
+  if (Function *F = dyn_cast<Function>(Entry)) {
+    Targets.insert(F);
+  } else if (!Entry->isNullValue()) {
+    // Null entries are abstract functions, which can't be called.
+    return false;
+  }
+
+  auto I = Subclasses.find(Vtbl);
+  if (I != Subclasses.end()) {
+    for (auto Sub : I->second) {
+      if (!collectTargets(Sub, Slot, Targets)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Replaces the invoke II by a branch on IsLikely to a direct invoke of
+/// Callee and to a copy of II.
+static void speculateInvoke(InvokeInst *II, Value *IsLikely, Value *Callee) {
+  BasicBlock *BB = II->getParent();
+  Function *F = BB->getParent();
+  LLVMContext &Ctx = F->getContext();
+  BasicBlock *Normal = II->getNormalDest();
+  BasicBlock *Unwind = II->getUnwindDest();
+
+  // The results of both invokes are merged on a new normal edge, which BB
+  // dominates just like the original one.
+  BasicBlock *Merge = BasicBlock::Create(Ctx, "devirt.cont", F, Normal);
+  BranchInst::Create(Normal, Merge);
+  for (auto &I : *Normal) {
+    auto PN = dyn_cast<PHINode>(&I);
+    if (!PN) {
+      break;
+    }
+    int Idx;
+    while ((Idx = PN->getBasicBlockIndex(BB)) >= 0) {
+      PN->setIncomingBlock(Idx, Merge);
+    }
+  }
+
+  BasicBlock *Then = BasicBlock::Create(Ctx, "devirt.direct", F, Merge);
+  BasicBlock *Else = BasicBlock::Create(Ctx, "devirt.indirect", F, Merge);
+
+  InvokeInst *Direct = cast<InvokeInst>(II->clone());
+  Direct->setCalledFunction(Callee);
+  Direct->setNormalDest(Merge);
+  Then->getInstList().push_back(Direct);
+
+  InvokeInst *Indirect = cast<InvokeInst>(II->clone());
+  Indirect->setNormalDest(Merge);
+  Else->getInstList().push_back(Indirect);
+
+  for (auto &I : *Unwind) {
+    auto PN = dyn_cast<PHINode>(&I);
+    if (!PN) {
+      break;
+    }
+    Value *V = PN->getIncomingValueForBlock(BB);
+    PN->removeIncomingValue(BB, false);
+    PN->addIncoming(V, Then);
+    PN->addIncoming(V, Else);
+  }
+
+  if (!II->getType()->isVoidTy()) {
+    PHINode *Phi = PHINode::Create(II->getType(), 2, "", &Merge->front());
+    Phi->addIncoming(Direct, Then);
+    Phi->addIncoming(Indirect, Else);
+    II->replaceAllUsesWith(Phi);
+    Phi->takeName(II);
+  }
+
+  BranchInst::Create(Then, Else, IsLikely, II);
+  II->eraseFromParent();
+}
+
+/// Calls the likely target directly if FnPtr equals it, and FnPtr otherwise.
+static void speculate(CallSite CS, Value *FnPtr, Function *Likely) {
+  IRBuilder<> Builder(CS.getInstruction());
+  Value *IsLikely = Builder.CreateICmpEQ(
+      FnPtr, ConstantExpr::getBitCast(Likely, FnPtr->getType()), ".devirt");
+  Value *Callee =
+      ConstantExpr::getBitCast(Likely, CS.getCalledValue()->getType());
+
+  if (CS.isInvoke()) {
+    speculateInvoke(cast<InvokeInst>(CS.getInstruction()), IsLikely, Callee);
+    return;
+  }
+
+  CallInst *CI = cast<CallInst>(CS.getInstruction());
+  TerminatorInst *ThenTerm = nullptr, *ElseTerm = nullptr;
+  SplitBlockAndInsertIfThenElse(IsLikely, CI, &ThenTerm, &ElseTerm);
+
+  CallInst *Direct = cast<CallInst>(CI->clone());
+  Direct->setCalledFunction(Callee);
+  Direct->insertBefore(ThenTerm);
+
+  CallInst *Indirect = cast<CallInst>(CI->clone());
+  Indirect->insertBefore(ElseTerm);
+
+  if (!CI->getType()->isVoidTy()) {
+    PHINode *Phi = PHINode::Create(CI->getType(), 2, "", CI);
+    Phi->addIncoming(Direct, Direct->getParent());
+    Phi->addIncoming(Indirect, Indirect->getParent());
+    CI->replaceAllUsesWith(Phi);
+    Phi->takeName(CI);
+  }
+  CI->eraseFromParent();
+}
+
+bool ClassHierarchyDevirt::devirtualize(LoadInst *Load) {
+  MDNode *Node = Load->getMetadata(VCALL_MD);
+  if (Node->getNumOperands() != 2) {
+    return false;
+  }
+  auto Vtbl = dyn_cast_or_null<GlobalVariable>(getConstantOperand(Node, 0));
+  auto Slot = dyn_cast_or_null<ConstantInt>(getConstantOperand(Node, 1));
+  if (!Vtbl || !Slot) {
+    return false;
+  }
+
+  SmallPtrSet<Function *, 4> Targets;
+  if (!collectTargets(Vtbl, Slot->getZExtValue(), Targets) ||
+      Targets.empty()) {
+    return false;
+  }
+
+  if (Targets.size() == 1) {
+    DEBUG(errs() << "Devirtualizing: " << *Load << '\n');
+    Load->replaceAllUsesWith(
+        ConstantExpr::getBitCast(*Targets.begin(), Load->getType()));
+    Load->eraseFromParent();
+    ++NumDevirtualized;
+    return true;
+  }
+
+  if (!Speculative) {
+    return false;
+  }
+
+  // Speculate on the implementation of the static type, if it has one.
+  Function *Likely = dyn_cast<Function>(
+      Vtbl->getInitializer()
+          ->getAggregateElement(Slot->getZExtValue())
+          ->stripPointerCasts());
+  if (!Likely) {
+    return false;
+  }
+
+  // The loaded function pointer is usually bitcast to the exact function
+  // type before being called.
+  SmallVector<CallSite, 4> Calls;
+  for (auto U : Load->users()) {
+    CallSite CS(U);
+    if (CS && CS.getCalledValue() == Load) {
+      Calls.push_back(CS);
+    } else if (auto BC = dyn_cast<BitCastInst>(U)) {
+      for (auto BU : BC->users()) {
+        CallSite BCS(BU);
+        if (BCS && BCS.getCalledValue() == BC) {
+          Calls.push_back(BCS);
+        }
+      }
+    }
+  }
+
+  for (auto CS : Calls) {
+    DEBUG(errs() << "Speculatively devirtualizing: " << *CS.getInstruction()
+                 << '\n');
+    speculate(CS, Load, Likely);
+    ++NumSpeculative;
+  }
+  return !Calls.empty();
+}
+
+bool ClassHierarchyDevirt::runOnModule(Module &M) {
+  NamedMDNode *Hierarchy = M.getNamedMetadata(CH_NAME);
+  if (!Hierarchy) {
+    return false;
+  }
+
+  Subclasses.clear();
+  for (unsigned i = 0, e = Hierarchy->getNumOperands(); i != e; ++i) {
+    MDNode *Node = Hierarchy->getOperand(i);
+    if (Node->getNumOperands() != CH_NumFields) {
+      continue;
+    }
+    auto Vtbl =
+        dyn_cast_or_null<GlobalVariable>(getConstantOperand(Node, CH_Vtbl));
+    auto Base =
+        dyn_cast_or_null<GlobalVariable>(getConstantOperand(Node, CH_BaseVtbl));
+    if (!Vtbl || !Base) {
+      continue;
+    }
+    auto &Subs = Subclasses[Base];
+    if (std::find(Subs.begin(), Subs.end(), Vtbl) == Subs.end()) {
+      Subs.push_back(Vtbl);
+    }
+  }
+
+  SmallVector<LoadInst *, 16> VirtualCalls;
+  for (auto &F : M) {
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        auto Load = dyn_cast<LoadInst>(&I);
+        if (Load && Load->getMetadata(VCALL_MD)) {
+          VirtualCalls.push_back(Load);
+        }
+      }
+    }
+  }
+
+  bool Changed = false;
+  for (auto Load : VirtualCalls) {
+    Changed |= devirtualize(Load);
+  }
+  return Changed;
+}
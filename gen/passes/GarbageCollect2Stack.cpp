@@ -87,6 +87,19 @@ static void EmitMemZero(IRBuilder<> &B, Value *Dst, Value *Len,
   EmitMemSet(B, Dst, ConstantInt::get(B.getInt8Ty(), 0), Len, A);
 }
 
+static void EmitMemCpy(IRBuilder<> &B, Value *Dst, Value *Src, Value *Len,
+                       const Analysis &A) {
+  Dst = B.CreateBitCast(Dst, PointerType::getUnqual(B.getInt8Ty()));
+  Src = B.CreateBitCast(Src, PointerType::getUnqual(B.getInt8Ty()));
+
+  CallSite CS =
+      B.CreateMemCpy(Dst, Src, Len, 1 /*Align*/, false /*isVolatile*/);
+  if (A.CGNode) {
+    A.CGNode->addCalledFunction(
+        CS, A.CG->getOrInsertFunction(CS.getCalledFunction()));
+  }
+}
+
 //===----------------------------------------------------------------------===//
 // Helpers for specific types of GC calls.
 //===----------------------------------------------------------------------===//
@@ -257,6 +270,8 @@ public:
 
 // FunctionInfo for _d_newclass
 class AllocClassFI : public FunctionInfo {
+  GlobalVariable *InitSymbol;
+
 public:
   bool analyze(CallSite CS, const Analysis &A) override {
     if (CS.arg_size() != 1) {
@@ -314,10 +329,31 @@ public:
 #else
     Ty = node->getOperand(CD_BodyType)->getType();
 #endif
+
+// The compiler relies on _d_newclass to copy the init symbol into the new
+// instance, so the stack memory has to be initialized from it instead.
+#if LDC_LLVM_VER >= 306
+    InitSymbol = mdconst::dyn_extract_or_null<GlobalVariable>(
+        node->getOperand(CD_InitSymbol));
+#else
+    InitSymbol =
+        dyn_cast_or_null<GlobalVariable>(node->getOperand(CD_InitSymbol));
+#endif
+    if (!InitSymbol) {
+      return false;
+    }
+
     return A.DL.getTypeAllocSize(Ty) < SizeLimit;
   }
 
-  // The default promote() should be fine.
+  Value *promote(CallSite CS, IRBuilder<> &B, const Analysis &A) override {
+    Value *alloca = FunctionInfo::promote(CS, B, A);
+    Value *Size = ConstantInt::get(A.DL.getIntPtrType(CS->getContext()),
+                                   A.DL.getTypeStoreSize(Ty));
+    // Use the original B to put initialization at the allocation site.
+    EmitMemCpy(B, alloca, InitSymbol, Size, A);
+    return alloca;
+  }
 
   AllocClassFI() : FunctionInfo(ReturnType::Pointer) {}
 };
@@ -458,6 +494,36 @@ static void RemoveCall(CallSite CS, const Analysis &A) {
   CS->eraseFromParent();
 }
 
+/// Returns whether argument ArgNo of the given call is known not to escape
+/// because it is passed to a D scope/lazy parameter (see SCOPE_ARGS_MD).
+static bool isScopeArgument(CallSite CS, unsigned ArgNo) {
+  MDNode *node = CS.getInstruction()->getMetadata(SCOPE_ARGS_MD);
+  if (!node || node->getNumOperands() == 0 ||
+      !CS.getArgument(ArgNo)->getType()->isStructTy()) {
+    return false;
+  }
+
+  for (unsigned i = 0, e = node->getNumOperands(); i != e; ++i) {
+#if LDC_LLVM_VER >= 306
+    auto idx = mdconst::dyn_extract<ConstantInt>(node->getOperand(i));
+#else
+    ConstantInt *idx = dyn_cast<ConstantInt>(node->getOperand(i));
+#endif
+    if (!idx) {
+      return false;
+    }
+    // The indices are stale if the call has been rewritten by an IPO pass.
+    if (i == 0) {
+      if (idx->getZExtValue() != CS.arg_size()) {
+        return false;
+      }
+    } else if (idx->getZExtValue() == ArgNo) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static bool
 isSafeToStackAllocateArray(BasicBlock::iterator Alloc, DominatorTree &DT,
                            SmallVector<CallInst *, 4> &RemoveTailCallInsts);
@@ -817,6 +883,10 @@ bool isSafeToStackAllocateArray(
 /// the memory it returns (which might not be equal to Alloc in case of
 /// functions returning D arrays).
 ///
+/// Passing the value (or a delegate containing it) to a D scope parameter, as
+/// recorded in SCOPE_ARGS_MD by DtoCallFunction(), does not count as capturing
+/// it.
+///
 /// If the value is used in a call instruction with the tail attribute set,
 /// the attribute has to be removed before promoting the memory to the
 /// stack. The affected instructions are added to RemoveTailCallInsts. If
@@ -862,7 +932,8 @@ bool isSafeToStackAllocate(BasicBlock::iterator Alloc, Value *V, DominatorTree &
       CallSite::arg_iterator B = CS.arg_begin(), E = CS.arg_end();
       for (CallSite::arg_iterator A = B; A != E; ++A) {
         if (A->get() == V) {
-          if (!CS.paramHasAttr(A - B + 1, LLAttribute::NoCapture)) {
+          if (!CS.paramHasAttr(A - B + 1, LLAttribute::NoCapture) &&
+              !isScopeArgument(CS, A - B)) {
             // The parameter is not marked 'nocapture' - captured.
             return false;
           }
@@ -889,6 +960,10 @@ bool isSafeToStackAllocate(BasicBlock::iterator Alloc, Value *V, DominatorTree &
       }
       // Storing to the pointee does not cause the pointer to be captured.
       break;
+    case Instruction::InsertValue:
+    case Instruction::ExtractValue:
+    // Closure pointers are passed around inside delegate aggregates; track
+    // them the same way as derived pointers.
     case Instruction::BitCast:
     case Instruction::GetElementPtr:
     case Instruction::PHI:
@@ -27,4 +27,10 @@ llvm::FunctionPass *createGarbageCollect2Stack();
 
 llvm::ModulePass *createStripExternalsPass();
 
+// Devirtualizes calls using the class hierarchy (whole-program only).
+llvm::ModulePass *createClassHierarchyDevirtPass();
+
+// Removes unreferenced TypeInfo and empty ModuleInfo data (whole-program only).
+llvm::ModulePass *createStripDeadTypeInfoPass();
+
 #endif
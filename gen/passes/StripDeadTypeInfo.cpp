@@ -0,0 +1,326 @@
+//===-- StripDeadTypeInfo.cpp - Remove unreferenced RTTI data -------------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass removes the TypeInfo instances, ClassInfos, vtables and init
+// symbols which are only referenced by other such data, e.g. the TypeInfo of
+// a struct which is only used to build the TypeInfo of a pointer to it, which
+// is never used either. It also removes the ModuleInfos of modules without
+// constructors, destructors, unit tests and local classes, along with their
+// entries in the .minfo section.
+//
+// This is only correct if the module contains the whole program, i.e. with
+// -singleobj or LTO: the symbols are removed even if they are externally
+// visible. Removed ModuleInfos are no longer listed when iterating over the
+// ModuleInfos at runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "strip-dead-typeinfo"
+
+#include "Passes.h"
+
+#include "llvm/Pass.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+STATISTIC(NumTypeInfos,
+          "Number of unreferenced TypeInfos, vtables and init symbols removed");
+STATISTIC(NumModuleInfos, "Number of empty ModuleInfos removed");
+
+static cl::opt<bool>
+    Report("strip-dead-typeinfo-report", cl::Hidden,
+           cl::desc("Print the number and size of the removed TypeInfo and "
+                    "ModuleInfo globals"));
+
+// These must match the values in gen/module.cpp and druntime.
+enum ModuleInfoFlags {
+  MItlsctor = 0x8,
+  MItlsdtor = 0x10,
+  MIctor = 0x20,
+  MIdtor = 0x40,
+  MIxgetMembers = 0x80,
+  MIictor = 0x100,
+  MIunitTest = 0x200,
+  MIimportedModules = 0x400,
+  MIlocalClasses = 0x800,
+};
+
+namespace {
+class LLVM_LIBRARY_VISIBILITY StripDeadTypeInfo : public ModulePass {
+  const DataLayout *DL = nullptr;
+  unsigned RemovedTypeInfos = 0;
+  unsigned RemovedModuleInfos = 0;
+  uint64_t TypeInfoBytes = 0;
+  uint64_t ModuleInfoBytes = 0;
+
+  uint64_t erase(GlobalVariable *GV);
+  bool stripModuleInfos(Module &M);
+  bool stripTypeInfos(Module &M);
+
+public:
+  static char ID; // Pass identification
+  StripDeadTypeInfo() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+};
+char StripDeadTypeInfo::ID = 0;
+} // end anonymous namespace.
+
+static RegisterPass<StripDeadTypeInfo>
+    X("strip-dead-typeinfo",
+      "Remove unreferenced TypeInfo and empty ModuleInfo data");
+
+// Public interface to the pass.
+ModulePass *createStripDeadTypeInfoPass() { return new StripDeadTypeInfo(); }
+
+/// Returns true for the D symbols of TypeInfos (including ClassInfos),
+/// vtables and init symbols.
+static bool isRTTISymbol(const GlobalVariable &GV) {
+  StringRef Name = GV.getName();
+  return Name.startswith("_D") &&
+         (Name.endswith("6__initZ") || Name.endswith("6__vtblZ") ||
+          Name.endswith("7__ClassZ") || Name.endswith("11__InterfaceZ"));
+}
+
+/// Returns true if V is used by anything but the initializers of the given
+/// globals.
+static bool hasOtherUses(Value *V,
+                         const SmallPtrSetImpl<GlobalVariable *> &Globals) {
+  for (auto U : V->users()) {
+    if (auto GV = dyn_cast<GlobalVariable>(U)) {
+      if (!Globals.count(GV)) {
+        return true;
+      }
+    } else if (isa<Constant>(U) && !isa<GlobalValue>(U)) {
+      if (hasOtherUses(U, Globals)) {
+        return true;
+      }
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Adds the globals referenced by C to Refs.
+static void collectGlobals(Constant *C, SmallPtrSetImpl<Constant *> &Visited,
+                           SmallVectorImpl<GlobalVariable *> &Refs) {
+  if (!Visited.insert(C).second) {
+    return;
+  }
+  if (auto GV = dyn_cast<GlobalVariable>(C)) {
+    Refs.push_back(GV);
+    return;
+  }
+  for (auto &Op : C->operands()) {
+    if (auto OpC = dyn_cast<Constant>(Op)) {
+      collectGlobals(OpC, Visited, Refs);
+    }
+  }
+}
+
+/// Erases GV, whose remaining uses must be dead, and returns its size.
+uint64_t StripDeadTypeInfo::erase(GlobalVariable *GV) {
+  uint64_t Size = 0;
+  if (GV->hasInitializer()) {
+    Size = DL->getTypeAllocSize(GV->getInitializer()->getType());
+  }
+  GV->removeDeadConstantUsers();
+  if (!GV->use_empty()) {
+    GV->replaceAllUsesWith(UndefValue::get(GV->getType()));
+  }
+  GV->eraseFromParent();
+  return Size;
+}
+
+/// Removes the given globals from llvm.used.
+static void removeFromUsed(Module &M,
+                           const SmallPtrSetImpl<GlobalValue *> &Remove) {
+  GlobalVariable *Used = M.getGlobalVariable("llvm.used");
+  if (!Used || !Used->hasInitializer()) {
+    return;
+  }
+  auto Init = dyn_cast<ConstantArray>(Used->getInitializer());
+  if (!Init) {
+    return;
+  }
+
+  SmallVector<Constant *, 16> Elems;
+  for (auto &Op : Init->operands()) {
+    auto C = cast<Constant>(Op);
+    auto GV = dyn_cast<GlobalValue>(C->stripPointerCasts());
+    if (!GV || !Remove.count(GV)) {
+      Elems.push_back(C);
+    }
+  }
+  if (Elems.size() == Init->getNumOperands()) {
+    return;
+  }
+
+  if (!Elems.empty()) {
+    auto Ty = ArrayType::get(Init->getType()->getElementType(), Elems.size());
+    auto NewUsed =
+        new GlobalVariable(M, Ty, false, Used->getLinkage(),
+                           ConstantArray::get(Ty, Elems), "", Used);
+    NewUsed->setSection(Used->getSection());
+    NewUsed->takeName(Used);
+  }
+  Used->eraseFromParent();
+}
+
+/// Returns true if the given ModuleInfo does not refer to any functions,
+/// imported modules or classes.
+static bool isEmptyModuleInfo(const GlobalVariable *MI) {
+  if (!MI->hasInitializer() || !MI->getName().endswith("12__ModuleInfoZ")) {
+    return false;
+  }
+  auto Init = dyn_cast<ConstantStruct>(MI->getInitializer());
+  if (!Init || Init->getNumOperands() == 0) {
+    return false;
+  }
+  auto Flags = dyn_cast<ConstantInt>(Init->getOperand(0));
+  const uint64_t NonEmpty = MItlsctor | MItlsdtor | MIctor | MIdtor |
+                            MIxgetMembers | MIictor | MIunitTest |
+                            MIimportedModules | MIlocalClasses;
+  return Flags && (Flags->getZExtValue() & NonEmpty) == 0;
+}
+
+bool StripDeadTypeInfo::stripModuleInfos(Module &M) {
+  // The module references in the .minfo section, see
+  // build_dso_registry_calls() in gen/module.cpp.
+  SmallVector<GlobalVariable *, 8> Dead, Kept;
+  for (auto &GV : M.getGlobalList()) {
+    if (GV.getSection() != ".minfo" || !GV.hasInitializer()) {
+      continue;
+    }
+    auto MI = dyn_cast<GlobalVariable>(
+        GV.getInitializer()->stripPointerCasts());
+    SmallPtrSet<GlobalVariable *, 1> Ref;
+    Ref.insert(&GV);
+    if (MI && isEmptyModuleInfo(MI) && !hasOtherUses(MI, Ref)) {
+      Dead.push_back(&GV);
+    } else {
+      Kept.push_back(&GV);
+    }
+  }
+  if (Dead.empty()) {
+    return false;
+  }
+
+  // The DSO constructors reference a module reference to keep the .minfo
+  // section alive with --gc-sections, so at least one of them has to stay.
+  if (Kept.empty()) {
+    Kept.push_back(Dead.pop_back_val());
+    if (Dead.empty()) {
+      return false;
+    }
+  }
+
+  SmallPtrSet<GlobalValue *, 8> Remove(Dead.begin(), Dead.end());
+  removeFromUsed(M, Remove);
+
+  for (auto Ref : Dead) {
+    auto MI = cast<GlobalVariable>(Ref->getInitializer()->stripPointerCasts());
+    DEBUG(errs() << "Removing empty ModuleInfo: " << MI->getName() << '\n');
+    Ref->replaceAllUsesWith(Kept.front());
+    ModuleInfoBytes += erase(Ref);
+    ModuleInfoBytes += erase(MI);
+    ++RemovedModuleInfos;
+    ++NumModuleInfos;
+  }
+  return true;
+}
+
+bool StripDeadTypeInfo::stripTypeInfos(Module &M) {
+  SmallPtrSet<GlobalVariable *, 64> Candidates;
+  for (auto &GV : M.getGlobalList()) {
+    if (GV.hasInitializer() && isRTTISymbol(GV)) {
+      Candidates.insert(&GV);
+    }
+  }
+
+  // Everything referenced from outside the candidates is live, and so is
+  // everything referenced by live candidates.
+  SmallPtrSet<GlobalVariable *, 64> Live;
+  SmallVector<GlobalVariable *, 64> Worklist;
+  for (auto GV : Candidates) {
+    if (hasOtherUses(GV, Candidates) && Live.insert(GV).second) {
+      Worklist.push_back(GV);
+    }
+  }
+  SmallPtrSet<Constant *, 64> Visited;
+  while (!Worklist.empty()) {
+    GlobalVariable *GV = Worklist.pop_back_val();
+    SmallVector<GlobalVariable *, 8> Refs;
+    collectGlobals(GV->getInitializer(), Visited, Refs);
+    for (auto Ref : Refs) {
+      if (Candidates.count(Ref) && Live.insert(Ref).second) {
+        Worklist.push_back(Ref);
+      }
+    }
+  }
+
+  SmallVector<GlobalVariable *, 64> Dead;
+  for (auto GV : Candidates) {
+    if (!Live.count(GV)) {
+      Dead.push_back(GV);
+    }
+  }
+  if (Dead.empty()) {
+    return false;
+  }
+
+  // The dead globals may reference each other, so drop all initializers
+  // first.
+  SmallVector<uint64_t, 64> Sizes;
+  for (auto GV : Dead) {
+    DEBUG(errs() << "Removing unreferenced RTTI symbol: " << GV->getName()
+                 << '\n');
+    Sizes.push_back(DL->getTypeAllocSize(GV->getInitializer()->getType()));
+    GV->setInitializer(nullptr);
+  }
+  for (size_t i = 0; i < Dead.size(); ++i) {
+    erase(Dead[i]);
+    TypeInfoBytes += Sizes[i];
+    ++RemovedTypeInfos;
+    ++NumTypeInfos;
+  }
+  return true;
+}
+
+bool StripDeadTypeInfo::runOnModule(Module &M) {
+#if LDC_LLVM_VER >= 307
+  DL = &M.getDataLayout();
+#else
+  DL = M.getDataLayout();
+#endif
+  RemovedTypeInfos = RemovedModuleInfos = 0;
+  TypeInfoBytes = ModuleInfoBytes = 0;
+
+  bool Changed = stripModuleInfos(M);
+  Changed |= stripTypeInfos(M);
+
+  if (Report) {
+    errs() << "strip-dead-typeinfo: removed " << RemovedTypeInfos
+           << " TypeInfo/vtable/init symbols (" << TypeInfoBytes
+           << " bytes) and " << RemovedModuleInfos << " ModuleInfos ("
+           << ModuleInfoBytes << " bytes)\n";
+  }
+  return Changed;
+}
@@ -25,6 +25,7 @@
 #include "module.h"
 #include "mtype.h"
 #include "root.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/Module.h"
@@ -46,7 +47,20 @@ static llvm::cl::opt<bool> nogc(
 // Internal LLVM module containing runtime declarations (functions and globals)
 static llvm::Module *M = nullptr;
 
+// A runtime function declaration. Lowering the D function type is relatively
+// expensive, so the LLVM function is only created when it is first used.
+struct PendingFwdDecl {
+  LINK linkage;
+  Type *returntype;
+  std::vector<Type *> paramtypes;
+  std::vector<StorageClass> paramsSTC;
+  AttrSet attribset;
+};
+
+static llvm::StringMap<PendingFwdDecl> pendingFwdDecls;
+
 static void buildRuntimeModule();
+static llvm::Function *createPendingFwdDecl(llvm::StringRef name);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -116,6 +130,7 @@ void freeRuntime() {
     delete M;
     M = nullptr;
   }
+  pendingFwdDecls.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -134,6 +149,9 @@ llvm::Function *getRuntimeFunction(const Loc &loc, llvm::Module &target,
   }
 
   fn = M->getFunction(name);
+  if (!fn) {
+    fn = createPendingFwdDecl(name);
+  }
   if (!fn) {
     error(loc, "Runtime function '%s' was not found", name);
     fatal();
@@ -226,17 +244,33 @@ static void createFwdDecl(LINK linkage, Type *returntype,
                           ArrayParam<Type *> paramtypes,
                           ArrayParam<StorageClass> paramsSTC = {},
                           AttrSet attribset = AttrSet()) {
+  for (auto fname : fnames) {
+    PendingFwdDecl &decl = pendingFwdDecls[fname];
+    decl.linkage = linkage;
+    decl.returntype = returntype;
+    decl.paramtypes.assign(paramtypes.begin(), paramtypes.end());
+    decl.paramsSTC.assign(paramsSTC.begin(), paramsSTC.end());
+    decl.attribset = attribset;
+  }
+}
+
+static llvm::Function *createPendingFwdDecl(llvm::StringRef fname) {
+  auto it = pendingFwdDecls.find(fname);
+  if (it == pendingFwdDecls.end()) {
+    return nullptr;
+  }
+  const PendingFwdDecl &decl = it->second;
 
   Parameters *params = nullptr;
-  if (!paramtypes.empty()) {
+  if (!decl.paramtypes.empty()) {
     params = new Parameters();
-    for (size_t i = 0, e = paramtypes.size(); i < e; ++i) {
-      StorageClass stc = paramsSTC.empty() ? 0 : paramsSTC[i];
-      params->push(new Parameter(stc, paramtypes[i], nullptr, nullptr));
+    for (size_t i = 0, e = decl.paramtypes.size(); i < e; ++i) {
+      StorageClass stc = decl.paramsSTC.empty() ? 0 : decl.paramsSTC[i];
+      params->push(new Parameter(stc, decl.paramtypes[i], nullptr, nullptr));
     }
   }
   int varargs = 0;
-  auto dty = new TypeFunction(params, returntype, varargs, linkage);
+  auto dty = new TypeFunction(params, decl.returntype, varargs, decl.linkage);
 
   // the call to DtoType performs many actions such as rewriting the function
   // type and storing it in dty
@@ -244,23 +278,24 @@ static void createFwdDecl(LINK linkage, Type *returntype,
   assert(dty->ctype);
   auto attrs =
       dty->ctype->getIrFuncTy().getParamAttrs(gABI->passThisBeforeSret(dty));
-  attrs.merge(attribset);
+  attrs.merge(decl.attribset);
 
-  for (auto fname : fnames) {
-    llvm::Function *fn = llvm::Function::Create(
-        llfunctype, llvm::GlobalValue::ExternalLinkage, fname, M);
+  llvm::Function *fn = llvm::Function::Create(
+      llfunctype, llvm::GlobalValue::ExternalLinkage, fname, M);
 
-    fn->setAttributes(attrs);
+  fn->setAttributes(attrs);
 
-    // On x86_64, always set 'uwtable' for System V ABI compatibility.
-    // FIXME: Move to better place (abi-x86-64.cpp?)
-    // NOTE: There are several occurances if this line.
-    if (global.params.targetTriple.getArch() == llvm::Triple::x86_64) {
-      fn->addFnAttr(LLAttribute::UWTable);
-    }
-
-    fn->setCallingConv(gABI->callingConv(fn->getFunctionType(), linkage));
+  // On x86_64, always set 'uwtable' for System V ABI compatibility.
+  // FIXME: Move to better place (abi-x86-64.cpp?)
+  // NOTE: There are several occurances if this line.
+  if (global.params.targetTriple.getArch() == llvm::Triple::x86_64) {
+    fn->addFnAttr(LLAttribute::UWTable);
   }
+
+  fn->setCallingConv(gABI->callingConv(fn->getFunctionType(), decl.linkage));
+
+  pendingFwdDecls.erase(it);
+  return fn;
 }
 
 static void buildRuntimeModule() {
@@ -313,6 +348,8 @@ static void buildRuntimeModule() {
                 llvm::Attribute::Cold),
       Attr_Cold_NoReturn(Attr_Cold, llvm::AttributeSet::FunctionIndex,
                          llvm::Attribute::NoReturn),
+      Attr_NoReturn(NoAttrs, llvm::AttributeSet::FunctionIndex,
+                    llvm::Attribute::NoReturn),
       Attr_ReadOnly_NoUnwind(Attr_ReadOnly, llvm::AttributeSet::FunctionIndex,
                              llvm::Attribute::NoUnwind),
       Attr_ReadOnly_1_NoCapture(Attr_ReadOnly, 1, llvm::Attribute::NoCapture),
@@ -610,7 +647,8 @@ static void buildRuntimeModule() {
   //////////////////////////////////////////////////////////////////////////////
 
   // void _d_throw_exception(Object e)
-  createFwdDecl(LINKc, voidTy, {"_d_throw_exception"}, {objectTy});
+  createFwdDecl(LINKc, voidTy, {"_d_throw_exception"}, {objectTy}, {},
+                Attr_NoReturn);
 
   //////////////////////////////////////////////////////////////////////////////
   //////////////////////////////////////////////////////////////////////////////
@@ -19,6 +19,7 @@
 #include "gen/llvm.h"
 #include "gen/llvmhelpers.h"
 #include "gen/logger.h"
+#include "gen/metadata.h"
 #include "gen/nested.h"
 #include "gen/tollvm.h"
 #include "ir/irfunction.h"
@@ -106,7 +107,8 @@ LLFunctionType *DtoExtractFunctionType(LLType *type) {
 static void addExplicitArguments(std::vector<LLValue *> &args, AttrSet &attrs,
                                  IrFuncTy &irFty, LLFunctionType *callableTy,
                                  const std::vector<DValue *> &argvals,
-                                 int numFormalParams) {
+                                 int numFormalParams, TypeFunction *tf,
+                                 std::vector<unsigned> &scopeArgs) {
   // Number of arguments added to the LLVM type that are implicit on the
   // frontend side of things (this, context pointers, etc.)
   const size_t implicitLLArgCount = args.size();
@@ -196,6 +198,17 @@ static void addExplicitArguments(std::vector<LLValue *> &args, AttrSet &attrs,
     // +1 as index 0 contains the function attributes.
     attrs.add(llArgIdx + 1, irArg->attrs);
 
+    // Remember delegates passed to non-escaping parameters, so that the
+    // GC2Stack pass can promote the closures they reference.
+    if (!isVararg && isaStruct(llVal) &&
+        argType->toBasetype()->ty == Tdelegate) {
+      Parameter *fnarg =
+          Parameter::getNth(tf->parameters, irArg->parametersIdx);
+      if (fnarg && !tf->parameterEscapes(fnarg)) {
+        scopeArgs.push_back(llArgIdx);
+      }
+    }
+
     if (isVararg) {
       delete irArg;
     }
@@ -837,12 +850,34 @@ DValue *DtoCallFunction(Loc &loc, Type *resulttype, DValue *fnval,
     argvals[i] = DtoArgument(nullptr, (*arguments)[i]);
   }
 
+  std::vector<unsigned> scopeArgs;
   addExplicitArguments(args, attrs, irFty, callableTy, argvals,
-                       numFormalParams);
+                       numFormalParams, tf, scopeArgs);
 
   // call the function
   LLCallSite call = gIR->func()->scopes->callOrInvoke(callable, args);
 
+  if (!scopeArgs.empty()) {
+    LLType *i32 = LLType::getInt32Ty(gIR->context());
+#if LDC_LLVM_VER >= 306
+    llvm::SmallVector<llvm::Metadata *, 4> mdVals;
+    mdVals.push_back(
+        llvm::ConstantAsMetadata::get(LLConstantInt::get(i32, args.size())));
+    for (auto idx : scopeArgs) {
+      mdVals.push_back(
+          llvm::ConstantAsMetadata::get(LLConstantInt::get(i32, idx)));
+    }
+#else
+    llvm::SmallVector<MDNodeField *, 4> mdVals;
+    mdVals.push_back(LLConstantInt::get(i32, args.size()));
+    for (auto idx : scopeArgs) {
+      mdVals.push_back(LLConstantInt::get(i32, idx));
+    }
+#endif
+    call.getInstruction()->setMetadata(
+        SCOPE_ARGS_MD, llvm::MDNode::get(gIR->context(), mdVals));
+  }
+
   // get return value
   const int sretArgIndex =
       (irFty.arg_sret && irFty.arg_this && gABI->passThisBeforeSret(tf) ? 1
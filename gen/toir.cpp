@@ -1371,7 +1371,7 @@ public:
           }
         }
 
-        p->ir->CreateCondBr(okCond, okbb, failbb);
+        DtoCondBrToFailure(okCond, okbb, failbb);
 
         p->scope() = IRScope(failbb);
         DtoBoundsCheckFailCall(p, e->loc);
@@ -1880,7 +1880,7 @@ public:
     LLValue *condval = DtoCast(e->loc, cond, Type::tbool)->getRVal();
 
     // branch
-    llvm::BranchInst::Create(passedbb, failedbb, condval, p->scopebb());
+    DtoCondBrToFailure(condval, passedbb, failedbb);
 
     // failed: call assert runtime function
     p->scope() = IRScope(failedbb);
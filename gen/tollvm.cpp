@@ -34,6 +34,7 @@
 #include "ir/irtypeclass.h"
 #include "ir/irtypefunction.h"
 #include "ir/irtypestruct.h"
+#include <algorithm>
 
 bool DtoIsInMemoryOnly(Type *type) {
   Type *typ = type->toBasetype();
@@ -378,6 +379,95 @@ void DtoMemCpy(LLValue *dst, LLValue *src, bool withPadding, unsigned align) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+namespace {
+typedef std::pair<uint64_t, LLConstant *> ConstantPart;
+
+/// Beyond this number of non-zero parts, copying the whole initializer is
+/// assumed to be cheaper than storing them one by one.
+const unsigned maxNonZeroParts = 8;
+
+/// Appends the non-zero scalars in c, which is located at the given offset,
+/// to parts. Returns false if there are too many of them.
+bool collectNonZeroParts(LLConstant *c, uint64_t offset,
+                         llvm::SmallVectorImpl<ConstantPart> &parts) {
+  if (c->isNullValue() || llvm::isa<llvm::UndefValue>(c)) {
+    return true;
+  }
+
+  LLType *type = c->getType();
+  if (auto st = llvm::dyn_cast<LLStructType>(type)) {
+    const llvm::StructLayout *layout = gDataLayout->getStructLayout(st);
+    for (unsigned i = 0, n = st->getNumElements(); i < n; ++i) {
+      if (!collectNonZeroParts(c->getAggregateElement(i),
+                               offset + layout->getElementOffset(i), parts)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (auto at = llvm::dyn_cast<LLArrayType>(type)) {
+    const uint64_t elemSize = getTypeAllocSize(at->getElementType());
+    for (uint64_t i = 0, n = at->getNumElements(); i < n; ++i) {
+      if (!collectNonZeroParts(c->getAggregateElement(i), offset + i * elemSize,
+                               parts)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Scalars, vectors and constant expressions like the vtable pointer.
+  if (parts.size() == maxNonZeroParts) {
+    return false;
+  }
+  parts.push_back(std::make_pair(offset, c));
+  return true;
+}
+}
+
+void DtoMemInitFromConstant(LLValue *dst, LLValue *src, LLConstant *init,
+                            uint64_t offset, uint64_t nbytes, unsigned align) {
+  llvm::SmallVector<ConstantPart, maxNonZeroParts> parts;
+  bool sparse = collectNonZeroParts(init, 0, parts);
+
+  // Only the parts within the range to initialize are of interest; bail out
+  // if one of them straddles its bounds.
+  const uint64_t end = offset + nbytes;
+  auto outside = [&](const ConstantPart &p) {
+    const uint64_t size = getTypeStoreSize(p.second->getType());
+    if (p.first + size <= offset || p.first >= end) {
+      return true;
+    }
+    if (p.first < offset || p.first + size > end) {
+      sparse = false;
+    }
+    return false;
+  };
+  parts.erase(std::remove_if(parts.begin(), parts.end(), outside),
+              parts.end());
+
+  if (!sparse) {
+    DtoMemCpy(dst, src, DtoConstSize_t(nbytes), align);
+    return;
+  }
+
+  IF_LOG Logger::println("Initializing %llu bytes with memset and %u stores",
+                         static_cast<unsigned long long>(nbytes),
+                         static_cast<unsigned>(parts.size()));
+  DtoMemSetZero(dst, DtoConstSize_t(nbytes), align);
+
+  LLValue *base = DtoBitCast(dst, getVoidPtrType());
+  for (const auto &p : parts) {
+    const uint64_t partOffset = p.first - offset;
+    LLValue *ptr = DtoGEPi1(base, static_cast<unsigned>(partOffset));
+    ptr = DtoBitCast(ptr, getPtrToType(p.second->getType()));
+    llvm::StoreInst *st = gIR->ir->CreateStore(p.second, ptr);
+    st->setAlignment(llvm::MinAlign(align, partOffset));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 LLValue *DtoMemCmp(LLValue *lhs, LLValue *rhs, LLValue *nbytes) {
   // int memcmp ( const void * ptr1, const void * ptr2, size_t num );
 
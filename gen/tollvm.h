@@ -195,6 +195,22 @@ void DtoMemCpy(LLValue *dst, LLValue *src, LLValue *nbytes, unsigned align = 1);
 void DtoMemCpy(LLValue *dst, LLValue *src, bool withPadding = false,
                unsigned align = 1);
 
+/**
+ * Initializes nbytes of memory at dst with the bytes of init starting at
+ * offset, where src points to the same bytes in a global. If these are mostly
+ * zero, a memset to zero followed by stores of the few non-zero parts is
+ * generated instead of copying from src.
+ * @param dst Destination memory.
+ * @param src Source memory, initialized with init from offset on.
+ * @param init The constant to initialize the memory with.
+ * @param offset The offset of the first byte to copy in init.
+ * @param nbytes Number of bytes to copy.
+ * @param align The minimum alignment of the destination memory.
+ */
+void DtoMemInitFromConstant(LLValue *dst, LLValue *src, LLConstant *init,
+                            uint64_t offset, uint64_t nbytes,
+                            unsigned align = 1);
+
 /**
  * Generates a call to C memcmp.
  */
@@ -1,5 +1,6 @@
 #include "gen/uda.h"
 
+#include "gen/irstate.h"
 #include "gen/llvm.h"
 #include "aggregate.h"
 #include "attrib.h"
@@ -8,22 +9,38 @@
 #include "module.h"
 
 #include "llvm/ADT/StringExtras.h"
+#if LDC_LLVM_VER >= 308
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#endif
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include <algorithm>
 
 namespace {
 
 /// Names of the attribute structs we recognize.
 namespace attr {
+const std::string fastmath = "_fastmath";
+const std::string llvmAttr = "llvmAttr";
+const std::string optStrategy = "optStrategy";
 const std::string section = "section";
 const std::string target  = "target";
+const std::string targetClones = "target_clones";
+const std::string unroll = "unroll";
+const std::string vectorize = "vectorize";
 const std::string weak    = "_weak";
 }
 
-/// Checks whether `moduleDecl` is the ldc.attributes module.
+/// Checks whether `moduleDecl` is the ldc.attributes module of druntime or the
+/// ldc.optimization module shipped with the compiler.
 bool isLdcAttibutes(const ModuleDeclaration *moduleDecl) {
   if (!moduleDecl)
     return false;
 
-  if (strcmp("attributes", moduleDecl->id->string)) {
+  if (strcmp("attributes", moduleDecl->id->string) &&
+      strcmp("optimization", moduleDecl->id->string)) {
     return false;
   }
 
@@ -81,29 +98,30 @@ void checkStructElems(StructLiteralExp *sle, llvm::ArrayRef<Type *> elemTypes) {
   }
 }
 
-const char *getFirstElemString(StructLiteralExp *sle) {
-  auto arg = (*sle->elements)[0];
+const char *getElemString(StructLiteralExp *sle, size_t i) {
+  auto arg = (*sle->elements)[i];
   assert(arg->op == TOKstring);
   auto strexp = static_cast<StringExp *>(arg);
   assert(strexp->sz == 1);
   return static_cast<const char *>(strexp->string);
 }
 
+dinteger_t getElemInteger(StructLiteralExp *sle, size_t i) {
+  return (*sle->elements)[i]->toInteger();
+}
+
 void applyAttrSection(StructLiteralExp *sle, llvm::GlobalObject *globj) {
   checkStructElems(sle, {Type::tstring});
-  globj->setSection(getFirstElemString(sle));
+  globj->setSection(getElemString(sle, 0));
 }
 
-void applyAttrTarget(StructLiteralExp *sle, llvm::Function *func) {
+void applyTargetSpec(const std::string &targetspec, llvm::Function *func) {
   // TODO: this is a rudimentary implementation for @target. Many more
   // target-related attributes could be applied to functions (not just for
   // @target): clang applies many attributes that LDC does not.
   // The current implementation here does not do any checking of the specified
   // string and simply passes all to llvm.
 
-  checkStructElems(sle, {Type::tstring});
-  std::string targetspec = getFirstElemString(sle);
-
   if (targetspec.empty() || targetspec == "default")
     return;
 
@@ -159,6 +177,366 @@ void applyAttrTarget(StructLiteralExp *sle, llvm::Function *func) {
   }
 }
 
+void applyAttrTarget(StructLiteralExp *sle, llvm::Function *func) {
+  checkStructElems(sle, {Type::tstring});
+  applyTargetSpec(getElemString(sle, 0), func);
+}
+
+void applyAttrOptStrategy(StructLiteralExp *sle, llvm::Function *func) {
+  checkStructElems(sle, {Type::tstring});
+  llvm::StringRef strategy = getElemString(sle, 0);
+
+  if (strategy == "none") {
+    // optnone requires noinline.
+    func->addFnAttr(llvm::Attribute::OptimizeNone);
+    func->addFnAttr(llvm::Attribute::NoInline);
+  } else if (strategy == "optsize") {
+    func->addFnAttr(llvm::Attribute::OptimizeForSize);
+  } else if (strategy == "minsize") {
+    func->addFnAttr(llvm::Attribute::MinSize);
+    func->addFnAttr(llvm::Attribute::OptimizeForSize);
+  } else {
+    sle->error("unrecognized optimization strategy '%s' in '%s'; expected "
+               "\"none\", \"optsize\" or \"minsize\"",
+               strategy.data(), sle->sd->toPrettyChars());
+  }
+}
+
+void applyAttrLLVMAttr(StructLiteralExp *sle, llvm::Function *func) {
+  checkStructElems(sle, {Type::tstring, Type::tstring});
+  llvm::StringRef key = getElemString(sle, 0);
+  llvm::StringRef value = getElemString(sle, 1);
+  if (value.empty()) {
+    func->addFnAttr(key);
+  } else {
+    func->addFnAttr(key, value);
+  }
+}
+
+/// The function attributes of @fastmath; the instructions are flagged once
+/// the body has been generated (see applyFastMathFlags()).
+void applyAttrFastMath(StructLiteralExp *sle, llvm::Function *func) {
+  checkStructElems(sle, {});
+  func->addFnAttr("unsafe-fp-math", "true");
+  func->addFnAttr("no-infs-fp-math", "true");
+  func->addFnAttr("no-nans-fp-math", "true");
+  func->addFnAttr("less-precise-fpmad", "true");
+}
+
+/// Allows all algebraic transformations on the floating-point operations of
+/// `func`.
+void applyFastMathFlags(llvm::Function *func) {
+  llvm::FastMathFlags fmf;
+  fmf.setUnsafeAlgebra();
+  for (auto &bb : *func) {
+    for (auto &inst : bb) {
+      if (llvm::isa<llvm::FPMathOperator>(&inst)) {
+        inst.setFastMathFlags(fmf);
+      }
+    }
+  }
+}
+
+#if LDC_LLVM_VER >= 308
+/// Appends the loop metadata for @unroll(count): a positive count requests
+/// unrolling by that factor, 0 disables unrolling.
+void addUnrollHint(StructLiteralExp *sle,
+                   llvm::SmallVectorImpl<llvm::Metadata *> &hints) {
+  checkStructElems(sle, {Type::tint32});
+  auto &context = gIR->context();
+  auto count = static_cast<int>(getElemInteger(sle, 0));
+  if (count < 0) {
+    sle->error("unroll count must not be negative");
+  } else if (count == 0) {
+    hints.push_back(llvm::MDNode::get(
+        context, llvm::MDString::get(context, "llvm.loop.unroll.disable")));
+  } else {
+    llvm::Metadata *ops[] = {
+        llvm::MDString::get(context, "llvm.loop.unroll.count"),
+        llvm::ConstantAsMetadata::get(
+            llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), count))};
+    hints.push_back(llvm::MDNode::get(context, ops));
+  }
+}
+
+/// Appends the loop metadata for @vectorize(width): 0 leaves the width to the
+/// vectorizer, 1 disables vectorization, other widths are forced.
+void addVectorizeHint(StructLiteralExp *sle,
+                      llvm::SmallVectorImpl<llvm::Metadata *> &hints) {
+  checkStructElems(sle, {Type::tint32});
+  auto &context = gIR->context();
+  auto width = static_cast<int>(getElemInteger(sle, 0));
+  auto i32 = llvm::Type::getInt32Ty(context);
+  if (width < 0) {
+    sle->error("vectorization width must not be negative");
+  } else if (width == 0) {
+    llvm::Metadata *ops[] = {
+        llvm::MDString::get(context, "llvm.loop.vectorize.enable"),
+        llvm::ConstantAsMetadata::get(
+            llvm::ConstantInt::get(llvm::Type::getInt1Ty(context), 1))};
+    hints.push_back(llvm::MDNode::get(context, ops));
+  } else {
+    llvm::Metadata *ops[] = {
+        llvm::MDString::get(context, "llvm.loop.vectorize.width"),
+        llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(i32, width))};
+    hints.push_back(llvm::MDNode::get(context, ops));
+  }
+}
+
+/// Attaches the given hints to all loops of `func`, each loop getting its own
+/// (self-referential) loop ID.
+void applyLoopHints(llvm::Function *func,
+                    llvm::ArrayRef<llvm::Metadata *> hints) {
+  llvm::DominatorTree domTree(*func);
+  llvm::LoopInfo loopInfo(domTree);
+  llvm::SmallVector<llvm::Loop *, 8> worklist(loopInfo.begin(),
+                                              loopInfo.end());
+  while (!worklist.empty()) {
+    llvm::Loop *loop = worklist.pop_back_val();
+    worklist.append(loop->begin(), loop->end());
+
+    llvm::SmallVector<llvm::Metadata *, 4> ops;
+    ops.push_back(nullptr); // replaced by the loop ID itself
+    ops.append(hints.begin(), hints.end());
+    llvm::MDNode *loopID = llvm::MDNode::getDistinct(func->getContext(), ops);
+    loopID->replaceOperandWith(0, loopID);
+    loop->setLoopID(loopID);
+  }
+}
+#endif
+
+/// Returns the target specifications of a @target_clones UDA, which holds a
+/// single string[] field.
+std::vector<std::string> getTargetClones(StructLiteralExp *sle) {
+  auto invalid = [sle]() {
+    sle->error("invalid field in '%s'; does the imported module not match "
+               "the compiler version?",
+               sle->sd->toPrettyChars());
+    fatal();
+  };
+
+  if (sle->elements->dim != 1 || (*sle->elements)[0]->op != TOKarrayliteral) {
+    invalid();
+  }
+
+  std::vector<std::string> targets;
+  auto ale = static_cast<ArrayLiteralExp *>((*sle->elements)[0]);
+  for (auto e : *ale->elements) {
+    if (e->op != TOKstring || static_cast<StringExp *>(e)->sz != 1) {
+      invalid();
+    }
+    auto strexp = static_cast<StringExp *>(e);
+    targets.emplace_back(static_cast<const char *>(strexp->string),
+                         strexp->len);
+  }
+  return targets;
+}
+
+/// Bits of the CPU features in __cpu_model.__cpu_features[0], as filled in by
+/// __cpu_indicator_init() of libgcc and compiler-rt (this is what
+/// __builtin_cpu_supports() tests in GCC and clang). The names are those of
+/// the LLVM target features.
+const struct {
+  const char *name;
+  unsigned bit;
+} cpuFeatureBits[] = {
+    {"cmov", 0},      {"mmx", 1},        {"popcnt", 2},     {"sse", 3},
+    {"sse2", 4},      {"sse3", 5},       {"ssse3", 6},      {"sse4.1", 7},
+    {"sse4.2", 8},    {"avx", 9},        {"avx2", 10},      {"sse4a", 11},
+    {"fma4", 12},     {"xop", 13},       {"fma", 14},       {"avx512f", 15},
+    {"bmi", 16},      {"bmi2", 17},      {"aes", 18},       {"pclmul", 19},
+    {"avx512vl", 20}, {"avx512bw", 21},  {"avx512dq", 22},  {"avx512cd", 23},
+    {"avx512er", 24}, {"avx512pf", 25},  {"avx512vbmi", 26},
+    {"avx512ifma", 27}};
+
+/// Returns the mask of the __cpu_model feature bits a clone for the given
+/// target specification (a comma-separated list of features) requires, or 0
+/// if the specification cannot be checked at runtime.
+uint32_t getCpuFeatureMask(FuncDeclaration *decl,
+                           const std::string &targetspec) {
+  uint32_t mask = 0;
+  llvm::SmallVector<llvm::StringRef, 4> fragments;
+  llvm::SplitString(targetspec, fragments, ",");
+  if (fragments.empty()) {
+    decl->error("empty target in @ldc.optimization.target_clones");
+    return 0;
+  }
+  for (auto s : fragments) {
+    s = s.trim();
+    bool found = false;
+    for (const auto &feature : cpuFeatureBits) {
+      if (s == feature.name) {
+        mask |= 1u << feature.bit;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      decl->error("cannot select a clone for '%s' at runtime; "
+                  "@ldc.optimization.target_clones only supports CPU "
+                  "features",
+                  targetspec.c_str());
+      return 0;
+    }
+  }
+  return mask;
+}
+
+/// Ends `bb` with a call of `callee` with the arguments of `func`, and returns
+/// the result.
+void emitForwardingCall(llvm::Function *func, llvm::Value *callee,
+                        llvm::BasicBlock *bb) {
+  llvm::IRBuilder<> b(bb);
+  std::vector<llvm::Value *> args;
+  for (auto I = func->arg_begin(), E = func->arg_end(); I != E; ++I) {
+    args.push_back(&*I);
+  }
+  llvm::CallInst *call = b.CreateCall(callee, args);
+  call->setCallingConv(func->getCallingConv());
+  call->setAttributes(func->getAttributes());
+  call->setTailCall();
+  if (func->getReturnType()->isVoidTy()) {
+    b.CreateRetVoid();
+  } else {
+    b.CreateRet(call);
+  }
+}
+
+/// Function multiversioning: Moves the body of `func` into one internal clone
+/// per target and turns `func` into a dispatcher calling the selected clone
+/// through a function pointer. The pointer initially refers to a resolver,
+/// which checks the features of the CPU on the first call and patches the
+/// pointer to the last listed clone the CPU supports ("default" if none).
+void emitTargetClones(FuncDeclaration *decl, llvm::Function *func,
+                      const std::vector<std::string> &targets) {
+  const auto &triple = global.params.targetTriple;
+  if ((triple.getArch() != llvm::Triple::x86 &&
+       triple.getArch() != llvm::Triple::x86_64) ||
+      triple.isWindowsMSVCEnvironment()) {
+    decl->error("@ldc.optimization.target_clones is only supported for x86 "
+                "targets using libgcc or compiler-rt");
+    return;
+  }
+  if (func->isVarArg()) {
+    decl->error("@ldc.optimization.target_clones cannot be applied to "
+                "C-style variadic functions");
+    return;
+  }
+
+  std::vector<std::pair<std::string, uint32_t>> specs;
+  bool hasDefault = false;
+  for (const auto &t : targets) {
+    if (t == "default") {
+      hasDefault = true;
+      continue;
+    }
+    uint32_t mask = getCpuFeatureMask(decl, t);
+    if (!mask) {
+      return;
+    }
+    specs.emplace_back(t, mask);
+  }
+  if (!hasDefault) {
+    decl->error(
+        "@ldc.optimization.target_clones requires a \"default\" target");
+    return;
+  }
+
+  llvm::Module &module = *func->getParent();
+  llvm::LLVMContext &context = module.getContext();
+
+  auto createClone = [&](const std::string &targetspec) {
+    llvm::ValueToValueMapTy vmap;
+#if LDC_LLVM_VER >= 309
+    llvm::Function *clone = llvm::CloneFunction(func, vmap);
+#else
+    llvm::Function *clone = llvm::CloneFunction(func, vmap, false);
+    module.getFunctionList().push_back(clone);
+#endif
+    std::string suffix = targetspec;
+    std::replace(suffix.begin(), suffix.end(), ',', '_');
+    clone->setName(func->getName() + "." + suffix);
+    // The clones stay in the COMDAT of func, if any, so that they are
+    // discarded along with it.
+    clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+    applyTargetSpec(targetspec, clone);
+    return clone;
+  };
+
+  llvm::Function *defaultClone = createClone("default");
+  std::vector<std::pair<llvm::Function *, uint32_t>> clones;
+  for (const auto &spec : specs) {
+    clones.emplace_back(createClone(spec.first), spec.second);
+  }
+
+  // deleteBody() resets the linkage.
+  const auto linkage = func->getLinkage();
+  func->deleteBody();
+  func->setLinkage(linkage);
+
+  auto resolver = llvm::Function::Create(func->getFunctionType(),
+                                         llvm::GlobalValue::InternalLinkage,
+                                         func->getName() + ".resolve", &module);
+  resolver->setCallingConv(func->getCallingConv());
+  resolver->setAttributes(func->getAttributes());
+  resolver->setComdat(func->getComdat());
+
+  auto fnPtrType = func->getType();
+  auto fnPtr = new llvm::GlobalVariable(
+      module, fnPtrType, false, llvm::GlobalValue::InternalLinkage, resolver,
+      func->getName() + ".resolved");
+  fnPtr->setComdat(func->getComdat());
+  const unsigned ptrAlign = gDataLayout->getABITypeAlignment(fnPtrType);
+#if LDC_LLVM_VER >= 309
+  const auto ordering = llvm::AtomicOrdering::Monotonic;
+#else
+  const auto ordering = llvm::Monotonic;
+#endif
+
+  // The dispatcher.
+  {
+    auto bb = llvm::BasicBlock::Create(context, "", func);
+    llvm::IRBuilder<> b(bb);
+    llvm::LoadInst *target = b.CreateAlignedLoad(fnPtr, ptrAlign);
+    target->setAtomic(ordering);
+    emitForwardingCall(func, target, bb);
+  }
+
+  // The resolver.
+  {
+    auto bb = llvm::BasicBlock::Create(context, "", resolver);
+    llvm::IRBuilder<> b(bb);
+
+    b.CreateCall(module.getOrInsertFunction(
+        "__cpu_indicator_init",
+        llvm::FunctionType::get(llvm::Type::getVoidTy(context), false)));
+
+    auto i32 = llvm::Type::getInt32Ty(context);
+    llvm::Type *cpuModelElems[] = {i32, i32, i32, llvm::ArrayType::get(i32, 1)};
+    auto cpuModelType = llvm::StructType::get(context, cpuModelElems);
+    auto cpuModel = module.getOrInsertGlobal("__cpu_model", cpuModelType);
+    llvm::Constant *idxs[] = {b.getInt32(0), b.getInt32(3), b.getInt32(0)};
+    llvm::Value *features =
+        b.CreateLoad(llvm::ConstantExpr::getGetElementPtr(
+#if LDC_LLVM_VER >= 307
+                         cpuModelType,
+#endif
+                         cpuModel, idxs, true),
+                     "cpu_features");
+
+    llvm::Value *selected = defaultClone;
+    for (const auto &clone : clones) {
+      auto mask = b.getInt32(clone.second);
+      auto supported = b.CreateICmpEQ(b.CreateAnd(features, mask), mask);
+      selected = b.CreateSelect(supported, clone.first, selected);
+    }
+
+    llvm::StoreInst *store = b.CreateAlignedStore(selected, fnPtr, ptrAlign);
+    store->setAtomic(ordering);
+    emitForwardingCall(resolver, selected, bb);
+  }
+}
+
 } // anonymous namespace
 
 void applyVarDeclUDAs(VarDeclaration *decl, llvm::GlobalVariable *gvar) {
@@ -175,9 +553,13 @@ void applyVarDeclUDAs(VarDeclaration *decl, llvm::GlobalVariable *gvar) {
     auto name = sle->sd->ident->string;
     if (name == attr::section) {
       applyAttrSection(sle, gvar);
-    } else if (name == attr::target) {
-      sle->error("Special attribute 'ldc.attributes.target' is only valid for "
-                 "functions");
+    } else if (name == attr::target || name == attr::targetClones ||
+               name == attr::optStrategy || name == attr::llvmAttr ||
+               name == attr::fastmath || name == attr::unroll ||
+               name == attr::vectorize) {
+      sle->error("Special attribute 'ldc.attributes.%s' is only valid for "
+                 "functions",
+                 sle->sd->ident->string);
     } else if (name == attr::weak) {
       // @weak is applied elsewhere
     } else {
@@ -188,6 +570,45 @@ void applyVarDeclUDAs(VarDeclaration *decl, llvm::GlobalVariable *gvar) {
   }
 }
 
+void checkFuncDeclUDAs(FuncDeclaration *decl) {
+  if (!decl->userAttribDecl)
+    return;
+
+  StructLiteralExp *optNone = nullptr;
+  StructLiteralExp *otherStrategy = nullptr;
+
+  Expressions *attrs = decl->userAttribDecl->getAttributes();
+  expandTuples(attrs);
+  for (auto &attr : *attrs) {
+    auto sle = getLdcAttributesStruct(attr);
+    if (!sle || sle->sd->ident->string != attr::optStrategy)
+      continue;
+
+    checkStructElems(sle, {Type::tstring});
+    if (llvm::StringRef(getElemString(sle, 0)) == "none") {
+      optNone = sle;
+    } else {
+      otherStrategy = sle;
+    }
+  }
+
+  if (!optNone)
+    return;
+
+  // optnone implies noinline, and LLVM rejects it together with the other
+  // optimization strategies.
+  if (otherStrategy) {
+    decl->error("@%s(\"%s\") cannot be combined with @%s(\"none\")",
+                otherStrategy->sd->toPrettyChars(),
+                getElemString(otherStrategy, 0),
+                optNone->sd->toPrettyChars());
+  }
+  if (decl->inlining == PINLINEalways) {
+    decl->error("@%s(\"none\") cannot be combined with pragma(inline, true)",
+                optNone->sd->toPrettyChars());
+  }
+}
+
 void applyFuncDeclUDAs(FuncDeclaration *decl, llvm::Function *func) {
   if (!decl->userAttribDecl)
     return;
@@ -204,6 +625,15 @@ void applyFuncDeclUDAs(FuncDeclaration *decl, llvm::Function *func) {
       applyAttrSection(sle, func);
     } else if (name == attr::target) {
       applyAttrTarget(sle, func);
+    } else if (name == attr::optStrategy) {
+      applyAttrOptStrategy(sle, func);
+    } else if (name == attr::llvmAttr) {
+      applyAttrLLVMAttr(sle, func);
+    } else if (name == attr::fastmath) {
+      applyAttrFastMath(sle, func);
+    } else if (name == attr::targetClones || name == attr::unroll ||
+               name == attr::vectorize) {
+      // applied once the body has been generated
     } else if (name == attr::weak) {
       // @weak is applied elsewhere
     } else {
@@ -214,6 +644,56 @@ void applyFuncDeclUDAs(FuncDeclaration *decl, llvm::Function *func) {
   }
 }
 
+void applyFuncDefUDAs(FuncDeclaration *decl, llvm::Function *func) {
+  if (!decl->userAttribDecl)
+    return;
+
+  bool fastmath = false;
+#if LDC_LLVM_VER >= 308
+  llvm::SmallVector<llvm::Metadata *, 4> loopHints;
+#endif
+  StructLiteralExp *targetClones = nullptr;
+
+  Expressions *attrs = decl->userAttribDecl->getAttributes();
+  expandTuples(attrs);
+  for (auto &attr : *attrs) {
+    auto sle = getLdcAttributesStruct(attr);
+    if (!sle)
+      continue;
+
+    auto name = sle->sd->ident->string;
+    if (name == attr::fastmath) {
+      fastmath = true;
+    } else if (name == attr::unroll || name == attr::vectorize) {
+#if LDC_LLVM_VER >= 308
+      if (name == attr::unroll) {
+        addUnrollHint(sle, loopHints);
+      } else {
+        addVectorizeHint(sle, loopHints);
+      }
+#else
+      warning(sle->loc, "ignoring '%s', loop hints require LLVM 3.8+",
+              sle->sd->toPrettyChars());
+#endif
+    } else if (name == attr::targetClones) {
+      targetClones = sle;
+    }
+  }
+
+  if (fastmath) {
+    applyFastMathFlags(func);
+  }
+#if LDC_LLVM_VER >= 308
+  if (!loopHints.empty()) {
+    applyLoopHints(func, loopHints);
+  }
+#endif
+  // Last, as the clones copy the body.
+  if (targetClones) {
+    emitTargetClones(decl, func, getTargetClones(targetClones));
+  }
+}
+
 /// Checks whether 'sym' has the @ldc.attributes._weak() UDA applied.
 bool hasWeakUDA(Dsymbol *sym) {
   if (!sym->userAttribDecl)
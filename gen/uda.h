@@ -23,7 +23,13 @@ class Function;
 class GlobalVariable;
 }
 
+/// Diagnoses invalid combinations of UDAs on a function during semantic
+/// analysis, e.g. @optStrategy("none") together with pragma(inline, true).
+void checkFuncDeclUDAs(FuncDeclaration *decl);
 void applyFuncDeclUDAs(FuncDeclaration *decl, llvm::Function *func);
+/// Applies the UDAs which need the generated body of the function, i.e.
+/// @target_clones.
+void applyFuncDefUDAs(FuncDeclaration *decl, llvm::Function *func);
 void applyVarDeclUDAs(VarDeclaration *decl, llvm::GlobalVariable *gvar);
 
 bool hasWeakUDA(Dsymbol *sym);
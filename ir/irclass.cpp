@@ -26,6 +26,7 @@
 #include "gen/llvmhelpers.h"
 #include "gen/arrays.h"
 #include "gen/metadata.h"
+#include "gen/optimizer.h"
 #include "gen/runtime.h"
 #include "gen/functions.h"
 #include "gen/abi.h"
@@ -106,6 +107,7 @@ LLGlobalVariable *IrAggr::getClassInfoSymbol() {
         LLConstantInt::get(LLType::getInt1Ty(gIR->context()), hasDestructor));
     mdVals[CD_CustomDelete] = llvm::ConstantAsMetadata::get(
         LLConstantInt::get(LLType::getInt1Ty(gIR->context()), hasCustomDelete));
+    mdVals[CD_InitSymbol] = llvm::ConstantAsMetadata::get(getInitSymbol());
 #else
     MDNodeField *mdVals[CD_NumFields];
     mdVals[CD_BodyType] = llvm::UndefValue::get(bodyType);
@@ -113,6 +115,7 @@ LLGlobalVariable *IrAggr::getClassInfoSymbol() {
         LLConstantInt::get(LLType::getInt1Ty(gIR->context()), hasDestructor);
     mdVals[CD_CustomDelete] =
         LLConstantInt::get(LLType::getInt1Ty(gIR->context()), hasCustomDelete);
+    mdVals[CD_InitSymbol] = getInitSymbol();
 #endif
     // Construct the metadata and insert it into the module.
     llvm::SmallString<64> name;
@@ -255,6 +258,28 @@ LLConstant *IrAggr::getVtblInit() {
              stripModifiers(type)->ctype->isClass()->getVtbl() &&
          "vtbl initializer type mismatch");
 
+  // Record the class hierarchy for the class hierarchy devirtualization pass.
+  if (opts::wholeProgramDevirt && !cd->isCPPclass()) {
+    llvm::Constant *baseVtbl =
+        llvm::ConstantPointerNull::get(getVtblSymbol()->getType());
+    if (cd->baseClass) {
+      // Base classes have already been resolved by DtoResolveClass().
+      baseVtbl = getIrAggr(cd->baseClass)->getVtblSymbol();
+    }
+#if LDC_LLVM_VER >= 306
+    llvm::Metadata *mdVals[CH_NumFields];
+    mdVals[CH_Vtbl] = llvm::ConstantAsMetadata::get(getVtblSymbol());
+    mdVals[CH_BaseVtbl] = llvm::ConstantAsMetadata::get(baseVtbl);
+#else
+    MDNodeField *mdVals[CH_NumFields];
+    mdVals[CH_Vtbl] = getVtblSymbol();
+    mdVals[CH_BaseVtbl] = baseVtbl;
+#endif
+    llvm::NamedMDNode *node = gIR->module.getOrInsertNamedMetadata(CH_NAME);
+    node->addOperand(llvm::MDNode::get(
+        gIR->context(), llvm::makeArrayRef(mdVals, CH_NumFields)));
+  }
+
   return constVtbl;
 }
 
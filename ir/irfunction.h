@@ -18,6 +18,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseMapInfo.h"
 #include "gen/llvm.h"
+#include "gen/coverage.h"
 #include "gen/irstate.h"
 #include "ir/irfuncty.h"
 #include <map>
@@ -365,6 +366,11 @@ llvm::CallSite ScopeStack::callOrInvoke(llvm::Value *callee, const T &args,
     if (calleeFn) {
       call->setAttributes(calleeFn->getAttributes());
     }
+    if (!doesNotThrow) {
+      // Unlike an invoke, the call doesn't end the basic block, but the rest
+      // of it is skipped if the callee unwinds to the caller.
+      endCoverageBlock();
+    }
     return call;
   }
 
@@ -453,6 +459,10 @@ struct IrFunction {
   /// Similar story to ehPtrSlot, but for the selector value.
   llvm::AllocaInst *ehSelectorSlot = nullptr;
 
+  /// For -cov=fast: The index of the coverage counter incremented in each
+  /// basic block.
+  llvm::DenseMap<llvm::BasicBlock *, unsigned> coverageBlockCounters;
+
 #if LDC_LLVM_VER >= 307
   llvm::DISubprogram *diSubprogram = nullptr;
   std::stack<llvm::DILexicalBlock *> diLexicalBlocks;